@@ -13,6 +13,11 @@
 #include "sequencer.h"
 #include "init.h"
 #include "remote_trigger.h"
+#include "io_event.h"
+#include "rules.h"
+#include "io_ledpixel.h"
+#include "ledpixel_effect.h"
+#include "gamma.h"
 #include "sdk.h"
 #include "spi.h"
 #include "display_eastrising.h"
@@ -457,6 +462,48 @@ static app_action_t application_function_bridge_port(app_params_t *parameters)
 	return(app_action_normal);
 }
 
+static app_action_t application_function_io_event_port(app_params_t *parameters)
+{
+	unsigned int port;
+
+	if(parse_uint(1, parameters->src, &port, 0, ' ') == parse_ok)
+	{
+		if(port > 65535)
+		{
+			string_format(parameters->dst, "> invalid port %u\n", port);
+			return(app_action_error);
+		}
+
+		if(port == 0)
+		{
+			if(!config_open_write() ||
+					!config_delete("io.event.port", false, -1, -1) ||
+					!config_close_write())
+			{
+				config_abort_write();
+				string_append(parameters->dst, "> cannot delete config (default values)\n");
+				return(app_action_error);
+			}
+		}
+		else
+			if(!config_open_write() ||
+					!config_set_int("io.event.port", port, -1, -1) ||
+					!config_close_write())
+			{
+				config_abort_write();
+				string_append(parameters->dst, "> cannot set config\n");
+				return(app_action_error);
+			}
+	}
+
+	if(!config_get_uint("io.event.port", &port, -1, -1))
+		port = 0;
+
+	string_format(parameters->dst, "> port: %u\n", port);
+
+	return(app_action_normal);
+}
+
 static app_action_t application_function_command_port(app_params_t *parameters)
 {
 	unsigned int port;
@@ -536,7 +583,9 @@ static app_action_t application_function_sequencer_add(app_params_t *parameters)
 	static unsigned int start = 0;
 	int io, pin, start_in;
 	unsigned int duration, value;
+	sequencer_ramp_t ramp;
 	bool active;
+	string_new(, ramp_string, 16);
 
 	if((parse_int(1, parameters->src, &start_in, 0, ' ') != parse_ok) ||
 			(parse_int(2, parameters->src, &io, 0, ' ') != parse_ok) ||
@@ -544,27 +593,36 @@ static app_action_t application_function_sequencer_add(app_params_t *parameters)
 			(parse_uint(4, parameters->src, &value, 0, ' ') != parse_ok) ||
 			(parse_uint(5, parameters->src, &duration, 0, ' ') != parse_ok))
 	{
-		string_append(parameters->dst, "> usage: sequencer-set index io pin value duration_ms\n");
+		string_append(parameters->dst, "> usage: sequencer-set index io pin value duration_ms [step|linear|gamma]\n");
+		return(app_action_error);
+	}
+
+	ramp = sequencer_ramp_none;
+
+	if((parse_string(6, parameters->src, &ramp_string, ' ') == parse_ok) && !sequencer_ramp_from_string(&ramp_string, &ramp))
+	{
+		string_append(parameters->dst, "> sequencer-set: ramp must be step, linear or gamma\n");
 		return(app_action_error);
 	}
 
 	if(start_in >= 0)
 		start = start_in;
 
-	if(!sequencer_set_entry(start, io, pin, value, duration))
+	if(!sequencer_set_entry(start, io, pin, value, duration, ramp))
 	{
 		string_append(parameters->dst, "> sequencer-set: error setting entry (set)\n");
 		return(app_action_error);
 	}
 
-	if(!sequencer_get_entry(start, &active, &io, &pin, &value, &duration))
+	if(!sequencer_get_entry(start, &active, &io, &pin, &value, &duration, &ramp))
 	{
 		string_append(parameters->dst, "> sequencer-set: error setting entry (get)\n");
 		return(app_action_error);
 	}
 
-	string_format(parameters->dst, "> sequencer-set: %u: %d/%d %u %u ms %s\n",
-			start, io, pin, value, duration, onoff(active));
+	string_format(parameters->dst, "> sequencer-set: %u: %d/%d %u %u ms ", start, io, pin, value, duration);
+	sequencer_ramp_to_string(parameters->dst, ramp);
+	string_format(parameters->dst, " %s\n", onoff(active));
 
 	start++;
 
@@ -575,20 +633,23 @@ static app_action_t application_function_sequencer_list(app_params_t *parameters
 {
 	static unsigned int start = 0;
 	unsigned int index, value, duration;
+	sequencer_ramp_t ramp;
 	int io, pin;
 	bool active;
 
 	if(parse_uint(1, parameters->src, &index, 0, ' ') == parse_ok)
 		start = index;
 
-	string_append(parameters->dst, "> index io pin value duration_ms\n");
+	string_append(parameters->dst, "> index io pin value duration_ms ramp\n");
 
 	for(index = 0; index < 20; index++, start++)
 	{
-		if(!sequencer_get_entry(start, &active, &io, &pin, &value, &duration))
+		if(!sequencer_get_entry(start, &active, &io, &pin, &value, &duration, &ramp))
 			break;
 
-		string_format(parameters->dst, "> %5u %2d %3d %5u       %5u %s\n", start, io, pin, value, duration, onoff(active));
+		string_format(parameters->dst, "> %5u %2d %3d %5u       %5u ", start, io, pin, value, duration);
+		sequencer_ramp_to_string(parameters->dst, ramp);
+		string_format(parameters->dst, " %s\n", onoff(active));
 	}
 
 	return(app_action_normal);
@@ -596,26 +657,73 @@ static app_action_t application_function_sequencer_list(app_params_t *parameters
 
 static app_action_t application_function_sequencer_start(app_params_t *parameters)
 {
-	unsigned int start, repeats;
+	unsigned int start, repeats, track;
 
 	if((parse_uint(1, parameters->src, &start, 0, ' ') != parse_ok) || (parse_uint(2, parameters->src, &repeats, 0, ' ') != parse_ok))
 	{
-		string_append(parameters->dst, "> usage: sequencer-play start_entry repeats\n");
+		string_format(parameters->dst, "> usage: sequencer-play start_entry repeats [track 0-%u]\n", sequencer_tracks - 1);
 		return(app_action_error);
 	}
 
-	sequencer_start(start, repeats);
+	if(parse_uint(3, parameters->src, &track, 0, ' ') != parse_ok)
+		track = 0;
+
+	if(!sequencer_start(track, start, repeats))
+	{
+		string_format(parameters->dst, "> sequencer: invalid track %u\n", track);
+		return(app_action_error);
+	}
 
-	string_format(parameters->dst, "> sequencer started: %u,%u ok\n", start, repeats);
+	string_format(parameters->dst, "> sequencer started: %u,%u track %u ok\n", start, repeats, track);
 
 	return(app_action_normal);
 }
 
 static app_action_t application_function_sequencer_stop(app_params_t *parameters)
 {
-	sequencer_stop();
+	unsigned int track;
+
+	if(parse_uint(1, parameters->src, &track, 0, ' ') != parse_ok)
+	{
+		sequencer_stop_all();
+		string_append(parameters->dst, "> sequencer stopped\n");
+		return(app_action_normal);
+	}
+
+	if(!sequencer_stop(track))
+	{
+		string_format(parameters->dst, "> sequencer: invalid track %u\n", track);
+		return(app_action_error);
+	}
+
+	string_format(parameters->dst, "> sequencer track %u stopped\n", track);
+
+	return(app_action_normal);
+}
+
+static app_action_t application_function_sequencer_upload(app_params_t *parameters)
+{
+	unsigned int sector;
+
+	if(parse_uint(1, parameters->src, &sector, 0, ' ') != parse_ok)
+	{
+		string_append(parameters->dst, "> usage: sequencer-upload sector (0-3) + sector data as oob data\n");
+		return(app_action_error);
+	}
+
+	if(string_length(parameters->src_oob) != SPI_FLASH_SEC_SIZE)
+	{
+		string_format(parameters->dst, "> sequencer-upload: sector data length mismatch: %d != %d\n", string_length(parameters->src_oob), SPI_FLASH_SEC_SIZE);
+		return(app_action_error);
+	}
+
+	if(!sequencer_upload(sector, string_length(parameters->src_oob), string_buffer_nonconst(parameters->src_oob)))
+	{
+		string_format(parameters->dst, "> sequencer-upload: sector %u failed\n", sector);
+		return(app_action_error);
+	}
 
-	string_append(parameters->dst, "> sequencer stopped\n");
+	string_format(parameters->dst, "> sequencer-upload: sector %u ok\n", sector);
 
 	return(app_action_normal);
 }
@@ -623,42 +731,66 @@ static app_action_t application_function_sequencer_stop(app_params_t *parameters
 static app_action_t application_function_stats_sequencer(app_params_t *parameters)
 {
 	bool running, active;
-	int io, pin;
-	unsigned int start, flash_size, flash_size_entries, flash_offset_flash0, flash_offset_flash1, flash_offset_mapped;
-	unsigned int current, value, duration;
+	int io, pin, current;
+	unsigned int tracks, track, late_last_us, late_max_us, flash_size, flash_size_entries, flash_offset_flash0, flash_offset_flash1, flash_offset_mapped;
+	unsigned int value, duration;
+	unsigned int cache_first, cache_entries, cache_hits, cache_misses;
+	bool cache_enabled, cache_valid;
+	sequencer_ramp_t ramp;
 
-	sequencer_get_status(&running, &start, &flash_size, &flash_size_entries, &flash_offset_flash0, &flash_offset_flash1, &flash_offset_mapped);
+	sequencer_get_cache_status(&cache_enabled, &cache_valid, &cache_first, &cache_entries, &cache_hits, &cache_misses);
+	sequencer_get_status(&running, &tracks, &late_last_us, &late_max_us, &flash_size, &flash_size_entries,
+			&flash_offset_flash0, &flash_offset_flash1, &flash_offset_mapped);
 
 	string_format(parameters->dst, "> sequencer\n>\n"
 			"> running: %s\n"
+			"> tracks: %u\n"
+			"> entry start lateness, last: %u us, max: %u us\n"
 			"> total flash size available: %u\n"
 			"> total entries in flash available: %u\n"
 			"> flash offset for ota image #0: 0x%06x\n"
 			"> flash offset for ota image #1: 0x%06x\n"
-			"> flash offset mapped into address space: 0x%08x\n",
+			"> flash offset mapped into address space: 0x%08x\n"
+			"> cache enabled: %s, loaded: %s, entries %u-%u, hits: %u, misses: %u\n",
 		yesno(running),
+		tracks,
+		late_last_us,
+		late_max_us,
 		flash_size,
 		flash_size_entries,
 		flash_offset_flash0,
 		flash_offset_flash1,
-		flash_offset_mapped);
+		flash_offset_mapped,
+		yesno(cache_enabled),
+		yesno(cache_valid),
+		cache_first,
+		cache_first + cache_entries - 1,
+		cache_hits,
+		cache_misses);
 
-	if(running)
+	for(track = 0; track < tracks; track++)
 	{
-		string_format(parameters->dst, "> starting from entry: %d\n"
+		if(sequencer_get_repeats(track) <= 0)
+			continue;
+
+		string_format(parameters->dst, ">\n> track %u\n"
+				"> starting from entry: %d\n"
 				"> repeats left: %d\n"
 				"> remaining duration from current entry: %u\n",
-			sequencer_get_start(),
-			sequencer_get_repeats() - 1,
-			(unsigned int)(sequencer_get_current_end_time() - (time_get_us() / 1000)));
+			track,
+			sequencer_get_start(track),
+			sequencer_get_repeats(track) - 1,
+			(unsigned int)(sequencer_get_current_end_time(track) - (time_get_us() / 1000)));
 
-		current = sequencer_get_current();
+		current = sequencer_get_current(track);
 
-		if(sequencer_get_entry(current, &active, &io, &pin, &value, &duration))
+		if(sequencer_get_entry(current, &active, &io, &pin, &value, &duration, &ramp))
 		{
 			string_append(parameters->dst, "> now playing:\n");
-			string_append(parameters->dst, "> index io pin value duration_ms\n");
-			string_format(parameters->dst, "> %5u %2d %3d %5u       %5u %s\n", current, io, pin, value, duration, onoff(active));
+			string_append(parameters->dst, "> index io pin value duration_ms ramp\n");
+			string_format(parameters->dst, "> %5d %2d %3d %5u       %5u ", current, io, pin, value, duration);
+			sequencer_ramp_to_string(parameters->dst, ramp);
+			string_format(parameters->dst, " %s\n", onoff(active));
 		}
 	}
 
@@ -1190,6 +1322,48 @@ static app_action_t application_function_i2c_write_read(app_params_t *parameters
 	return(app_action_normal);
 }
 
+static app_action_t application_function_i2c_script(app_params_t *parameters)
+{
+	i2c_error_t error;
+	static uint8_t reply[128];
+	unsigned int reply_length, step, current;
+	uint32_t from, to;
+
+	if(string_length(parameters->src_oob) == 0)
+	{
+		string_append(parameters->dst, "> usage: i2c-script + script as oob data, each operation is an opcode followed by its parameters\n");
+		string_append(parameters->dst, ">   0: end, 1: write <address> <length> <data>..., 2: read <address> <length>\n");
+		string_append(parameters->dst, ">   3: write-read <address> <length> <data>... <read length>, 4: delay <ms msb> <ms lsb>\n");
+		string_append(parameters->dst, ">   5: select bus <bus>, 6: poll <address> <register> <mask> <value> <timeout ms msb> <timeout ms lsb>\n");
+		string_format(parameters->dst, ">   delay and poll take at most %u ms per script, at most %u bytes are read\n", i2c_script_wait_max_ms, (unsigned int)sizeof(reply));
+		return(app_action_error);
+	}
+
+	i2c_select_bus(i2c_bus);
+
+	from = system_get_time();
+
+	if((error = i2c_script(string_length(parameters->src_oob), (const uint8_t *)string_buffer(parameters->src_oob),
+			sizeof(reply), reply, &reply_length, &step)) != i2c_error_ok)
+	{
+		string_format(parameters->dst, "i2c-script: operation %u", step);
+		i2c_error_format_string(parameters->dst, error);
+		string_append(parameters->dst, "\n");
+		return(app_action_error);
+	}
+
+	to = system_get_time();
+
+	string_format(parameters->dst, "> i2c-script: %u operations in %u microseconds, read %u bytes:", step, to - from, reply_length);
+
+	for(current = 0; current < reply_length; current++)
+		string_format(parameters->dst, " %02x", reply[current]);
+
+	string_append(parameters->dst, "\n");
+
+	return(app_action_normal);
+}
+
 static app_action_t application_function_i2c_speed(app_params_t *parameters)
 {
 	unsigned int speed_delay;
@@ -1235,9 +1409,102 @@ static app_action_t application_function_i2c_speed(app_params_t *parameters)
 	return(app_action_normal);
 }
 
+static app_action_t application_function_i2c_speed_calibrate(app_params_t *parameters)
+{
+	enum { calibrate_rounds = 8 };
+	unsigned int target_khz, address, speed_delay, bus_hz, round;
+	i2c_error_t error;
+
+	if(!config_get_uint("i2c.speed_delay", &speed_delay, -1, -1))
+		speed_delay = 1000;
+
+	if(parse_uint(2, parameters->src, &address, 0, ' ') != parse_ok)
+		address = 0x7f; // reserved, nothing should answer
+
+	if(address > 0x7f)
+	{
+		string_format(parameters->dst, "> invalid i2c address: 0x%02x\n", address);
+		return(app_action_error);
+	}
+
+	i2c_select_bus(i2c_bus);
+
+	if(parse_uint(1, parameters->src, &target_khz, 0, ' ') == parse_ok)
+	{
+		if((target_khz < 1) || (target_khz > 1000))
+		{
+			string_format(parameters->dst, "> invalid i2c target speed (1-1000 kHz): %u\n", target_khz);
+			return(app_action_error);
+		}
+
+		// the nominal delay is a starting point, scale it by the measured speed until it's within 2%
+
+		speed_delay = (100 * 1000) / target_khz;
+
+		for(round = 0; round < calibrate_rounds; round++)
+		{
+			i2c_speed_delay(speed_delay);
+
+			if((error = i2c_speed_measure(address, &bus_hz)) != i2c_error_ok)
+			{
+				string_append(parameters->dst, "i2c-speed-calibrate");
+				i2c_error_format_string(parameters->dst, error);
+				string_append(parameters->dst, "\n");
+				return(app_action_error);
+			}
+
+			string_format(parameters->dst, "> speed delay %5u: %u Hz\n", speed_delay, bus_hz);
+
+			if((bus_hz > (target_khz * 980)) && (bus_hz < (target_khz * 1020)))
+				break;
+
+			speed_delay = (unsigned int)(((uint64_t)speed_delay * bus_hz) / (target_khz * 1000));
+
+			if(speed_delay > 65535)
+				speed_delay = 65535;
+		}
+
+		if(speed_delay == 1000)
+		{
+			if(!config_open_write() ||
+					!config_delete("i2c.speed_delay", false, -1, -1) ||
+					!config_close_write())
+			{
+				config_abort_write();
+				string_append(parameters->dst, "> cannot delete config (default values)\n");
+				return(app_action_error);
+			}
+		}
+		else
+			if(!config_open_write() ||
+					!config_set_int("i2c.speed_delay", speed_delay, -1, -1) ||
+					!config_close_write())
+			{
+				config_abort_write();
+				string_append(parameters->dst, "> cannot set config\n");
+				return(app_action_error);
+			}
+	}
+
+	i2c_speed_delay(speed_delay);
+
+	if((error = i2c_speed_measure(address, &bus_hz)) != i2c_error_ok)
+	{
+		string_append(parameters->dst, "i2c-speed-calibrate");
+		i2c_error_format_string(parameters->dst, error);
+		string_append(parameters->dst, "\n");
+		return(app_action_error);
+	}
+
+	string_format(parameters->dst, "> i2c speed delay: %u, nominal: %u Hz, measured: %u Hz\n",
+			speed_delay, speed_delay ? (100000 * 1000) / speed_delay : 0, bus_hz);
+
+	return(app_action_normal);
+}
+
 static app_action_t application_function_i2c_sensor_read(app_params_t *parameters)
 {
-	unsigned int intin, bus;
+	unsigned int intin, bus, max_age_ms;
 	i2c_sensor_t sensor;
 
 	if((parse_uint(1, parameters->src, &intin, 0, ' ')) != parse_ok)
@@ -1257,7 +1524,10 @@ static app_action_t application_function_i2c_sensor_read(app_params_t *parameter
 		return(app_action_error);
 	}
 
-	if(!i2c_sensor_read(parameters->dst, bus, sensor, true, false))
+	if((parse_uint(3, parameters->src, &max_age_ms, 0, ' ')) != parse_ok)
+		max_age_ms = i2c_sensor_max_age_auto;
+
+	if(!i2c_sensor_read(parameters->dst, bus, sensor, max_age_ms, true, false))
 	{
 		string_clear(parameters->dst);
 		string_format(parameters->dst, "> invalid i2c sensor: %u/%u\n", bus, sensor);
@@ -1269,6 +1539,116 @@ static app_action_t application_function_i2c_sensor_read(app_params_t *parameter
 	return(app_action_normal);
 }
 
+static app_action_t application_function_i2c_sensor_interval(app_params_t *parameters)
+{
+	unsigned int intin, bus, interval_ms;
+	i2c_sensor_t sensor;
+
+	if(parse_uint(1, parameters->src, &intin, 0, ' ') != parse_ok)
+	{
+		string_append(parameters->dst, "> missing i2c sensor\n");
+		return(app_action_error);
+	}
+
+	if(parse_uint(2, parameters->src, &bus, 0, ' ') != parse_ok)
+		bus = 0;
+
+	if(bus >= i2c_busses)
+	{
+		string_format(parameters->dst, "> invalid i2c bus: %u\n", bus);
+		return(app_action_error);
+	}
+
+	if(intin >= i2c_sensor_size)
+	{
+		string_format(parameters->dst, "> invalid i2c sensor: %u/%u\n", bus, intin);
+		return(app_action_error);
+	}
+
+	sensor = (i2c_sensor_t)intin;
+
+	if(parse_uint(3, parameters->src, &interval_ms, 0, ' ') == parse_ok)
+	{
+		if(interval_ms > i2c_sensor_interval_max_ms)
+		{
+			string_format(parameters->dst, "> interval must be at most %u ms\n", i2c_sensor_interval_max_ms);
+			return(app_action_error);
+		}
+
+		if(!config_open_write())
+		{
+			config_abort_write();
+			string_append(parameters->dst, "cannot open config for writing\n");
+			return(app_action_error);
+		}
+
+		config_delete("i2s.interval.%u.%u", false, bus, sensor);
+
+		if(interval_ms && !config_set_uint("i2s.interval.%u.%u", interval_ms, bus, sensor))
+		{
+			config_abort_write();
+			string_append(parameters->dst, "> cannot set interval\n");
+			return(app_action_error);
+		}
+
+		if(!config_close_write())
+		{
+			string_append(parameters->dst, "> cannot write config\n");
+			return(app_action_error);
+		}
+
+		if(!i2c_sensor_set_interval(bus, sensor, interval_ms))
+			string_format(parameters->dst, "> i2c sensor %u/%u not active, interval will be used after detection\n", bus, sensor);
+	}
+
+	if(!config_get_uint("i2s.interval.%u.%u", &interval_ms, bus, sensor))
+		interval_ms = 0;
+
+	if(interval_ms)
+		string_format(parameters->dst, "> i2c sensor %u/%u sample interval: %u ms, keeping %u samples\n", bus, sensor, interval_ms, i2c_sensor_history_size);
+	else
+		string_format(parameters->dst, "> i2c sensor %u/%u sample interval: every background round, no history\n", bus, sensor);
+
+	return(app_action_normal);
+}
+
+static app_action_t application_function_i2c_sensor_history(app_params_t *parameters)
+{
+	unsigned int intin, bus, window_s, list;
+
+	if(parse_uint(1, parameters->src, &intin, 0, ' ') != parse_ok)
+	{
+		string_append(parameters->dst, "> missing i2c sensor\n");
+		return(app_action_error);
+	}
+
+	if(parse_uint(2, parameters->src, &bus, 0, ' ') != parse_ok)
+		bus = 0;
+
+	if(bus >= i2c_busses)
+	{
+		string_format(parameters->dst, "> invalid i2c bus: %u\n", bus);
+		return(app_action_error);
+	}
+
+	if(intin >= i2c_sensor_size)
+	{
+		string_format(parameters->dst, "> invalid i2c sensor: %u/%u\n", bus, intin);
+		return(app_action_error);
+	}
+
+	if(parse_uint(3, parameters->src, &window_s, 0, ' ') != parse_ok)
+		window_s = 0;
+
+	if(parse_uint(4, parameters->src, &list, 0, ' ') != parse_ok)
+		list = 0;
+
+	if(!i2c_sensor_history(parameters->dst, bus, (i2c_sensor_t)intin, window_s, !!list))
+		return(app_action_error);
+
+	return(app_action_normal);
+}
+
 static app_action_t application_function_i2c_sensor_calibrate(app_params_t *parameters)
 {
 	unsigned int intin, bus;
@@ -1350,7 +1730,7 @@ static app_action_t application_function_i2c_sensor_calibrate(app_params_t *para
 
 static app_action_t application_function_i2c_sensor_dump(app_params_t *parameters)
 {
-	unsigned int option;
+	unsigned int option, max_age_ms;
 	bool verbose;
 	int original_length;
 
@@ -1360,7 +1740,11 @@ static app_action_t application_function_i2c_sensor_dump(app_params_t *parameter
 	if((parse_uint(1, parameters->src, &option, 0, ' ') == parse_ok) && option)
 		verbose = true;
 
-	i2c_sensor_dump(verbose, parameters->dst);
+	if(parse_uint(2, parameters->src, &max_age_ms, 0, ' ') != parse_ok)
+		max_age_ms = i2c_sensor_max_age_auto;
+
+	i2c_sensor_dump(verbose, max_age_ms, parameters->dst);
+	io_frequency_dump(parameters->dst);
 
 	if(string_length(parameters->dst) == original_length)
 		string_append(parameters->dst, "> no sensors detected\n");
@@ -2074,7 +2458,9 @@ roflash static const char help_description_gpio_pcint[] =			"set gpio to trigger
 roflash static const char help_description_i2c_address[] =			"set i2c slave address";
 roflash static const char help_description_i2c_bus[] =				"set i2c mux bus number (0-8)";
 roflash static const char help_description_i2c_read[] =				"read data from i2c slave";
+roflash static const char help_description_i2c_script[] =			"run a sequence of i2c operations from oob data";
 roflash static const char help_description_i2c_speed[] =			"set i2c bus speed, 1000 (default) is 100 kHz, 0 is unconstrained";
+roflash static const char help_description_i2c_speed_calibrate[] =	"measure i2c bus speed, optionally calibrate to target speed (kHz) [<address>]";
 roflash static const char help_description_i2c_write[] =			"write data to i2c slave";
 roflash static const char help_description_i2c_write_read[] =		"write data to i2c slave and read back data";
 roflash static const char help_description_io_mode[] =				"config i/o pin";
@@ -2085,12 +2471,22 @@ roflash static const char help_description_io_resume[] = 			"resume i/o pin <i/o
 roflash static const char help_description_trigger_remote[] = 		"remote trigger: <index> <ip>";
 roflash static const char help_description_io_write[] =				"write to i/o pin";
 roflash static const char help_description_io_multiple[] =			"write to multiple pins from one I/O";
+roflash static const char help_description_io_write_multi[] =		"write to multiple digital output pins, batched per I/O";
+roflash static const char help_description_io_events[] =			"show pin change events [from sequence], subscribe on the io event port for a stream";
+roflash static const char help_description_io_event_port[] =		"set io event tcp/udp port (default 0 = off, takes effect after reset)";
+roflash static const char help_description_rule_set[] =			"set or delete local rule <index> [<rule>]";
+roflash static const char help_description_rule_list[] =			"list local rules";
+roflash static const char help_description_ledpixel_fb[] =			"ledpixel framebuffer [status | set <pixel> <value> [<count>] | show]";
+roflash static const char help_description_gamma[] =				"gamma correction [ledpixel|pwm <gamma * 10> | dither <0|1>]";
+roflash static const char help_description_ledpixel_effect[] =		"ledpixel effect [off | <effect> [<period ms> [<parameter> [<colour> ...]]]]";
 roflash static const char help_description_io_set_flag[] =			"set i/o pin flag";
 roflash static const char help_description_pwm1_width[] =			"set pwm1 width";
 roflash static const char help_description_io_clear_flag[] =		"clear i/o pin flag";
-roflash static const char help_description_i2c_sensor_read[] =		"read from i2c sensor";
+roflash static const char help_description_i2c_sensor_read[] =		"read from i2c sensor, <sensor> [<bus> [<max age ms, 0 = fresh>]]";
 roflash static const char help_description_i2c_sensor_calibrate[] =	"calibrate i2c sensor, use sensor factor offset";
-roflash static const char help_description_i2c_sensor_dump[] =		"dump all i2c sensors";
+roflash static const char help_description_i2c_sensor_interval[] =	"i2c sensor sample interval, <sensor> [<bus> [<interval ms, 0 = every round>]]";
+roflash static const char help_description_i2c_sensor_history[] =	"i2c sensor history min/max/mean/stddev, <sensor> [<bus> [<window s, 0 = all> [<list 0/1>]]]";
+roflash static const char help_description_i2c_sensor_dump[] =		"dump all i2c sensors [<verbose> [<max age ms, 0 = fresh>]]";
 roflash static const char help_description_log_display[] =			"display log";
 roflash static const char help_description_log_clear[] =			"display and clear the log";
 roflash static const char help_description_log_write[] =			"write to the log";
@@ -2106,6 +2502,7 @@ roflash static const char help_description_sequencer_list[] =		"list sequencer e
 roflash static const char help_description_sequencer_remove[] =		"remove sequencer entry";
 roflash static const char help_description_sequencer_start[] =		"start sequencer";
 roflash static const char help_description_sequencer_stop[] =		"stop sequencer";
+roflash static const char help_description_sequencer_upload[] =	"upload sector of sequencer entries";
 roflash static const char help_description_uart_baud[] =			"set uart baud rate [1-1000000]";
 roflash static const char help_description_uart_data[] =			"set uart data bits [5/6/7/8]";
 roflash static const char help_description_uart_stop[] =			"set uart stop bits [1/2]";
@@ -2277,11 +2674,21 @@ roflash static const application_function_table_t application_function_table[] =
 		application_function_i2c_read,
 		help_description_i2c_read,
 	},
+	{
+		"i2sr", "i2c-script",
+		application_function_i2c_script,
+		help_description_i2c_script,
+	},
 	{
 		"i2s", "i2c-speed",
 		application_function_i2c_speed,
 		help_description_i2c_speed,
 	},
+	{
+		"i2sc", "i2c-speed-calibrate",
+		application_function_i2c_speed_calibrate,
+		help_description_i2c_speed_calibrate,
+	},
 	{
 		"i2w", "i2c-write",
 		application_function_i2c_write,
@@ -2362,6 +2769,46 @@ roflash static const application_function_table_t application_function_table[] =
 		application_function_io_set_mask,
 		help_description_io_multiple,
 	},
+	{
+		"iwm", "io-write-multi",
+		application_function_io_write_multi,
+		help_description_io_write_multi,
+	},
+	{
+		"ie", "io-events",
+		application_function_io_events,
+		help_description_io_events,
+	},
+	{
+		"iep", "io-event-port",
+		application_function_io_event_port,
+		help_description_io_event_port,
+	},
+	{
+		"rus", "rule-set",
+		application_function_rule_set,
+		help_description_rule_set,
+	},
+	{
+		"rul", "rule-list",
+		application_function_rule_list,
+		help_description_rule_list,
+	},
+	{
+		"lfb", "ledpixel-fb",
+		application_function_ledpixel_fb,
+		help_description_ledpixel_fb,
+	},
+	{
+		"lef", "ledpixel-effect",
+		application_function_ledpixel_effect,
+		help_description_ledpixel_effect,
+	},
+	{
+		"gam", "gamma",
+		application_function_gamma,
+		help_description_gamma,
+	},
 	{
 		"isf", "io-set-flag",
 		application_function_io_set_flag,
@@ -2387,6 +2834,16 @@ roflash static const application_function_table_t application_function_table[] =
 		application_function_i2c_sensor_calibrate,
 		help_description_i2c_sensor_calibrate,
 	},
+	{
+		"isi", "i2c-sensor-interval",
+		application_function_i2c_sensor_interval,
+		help_description_i2c_sensor_interval,
+	},
+	{
+		"ish", "i2c-sensor-history",
+		application_function_i2c_sensor_history,
+		help_description_i2c_sensor_history,
+	},
 	{
 		"isd", "i2c-sensor-dump",
 		application_function_i2c_sensor_dump,
@@ -2467,6 +2924,11 @@ roflash static const application_function_table_t application_function_table[] =
 		application_function_sequencer_stop,
 		help_description_sequencer_stop,
 	},
+	{
+		"seu", "sequencer-upload",
+		application_function_sequencer_upload,
+		help_description_sequencer_upload,
+	},
 	{
 		"ub", "uart-baud",
 		application_function_uart_baud_rate,
@@ -2612,6 +3074,21 @@ roflash static const application_function_table_t application_function_table[] =
 		application_function_flash_checksum,
 		(void *)0,
 	},
+	{
+		"flash-checksum-start", "flash-checksum-start",
+		application_function_flash_checksum_start,
+		(void *)0,
+	},
+	{
+		"flash-checksum-status", "flash-checksum-status",
+		application_function_flash_checksum_status,
+		(void *)0,
+	},
+	{
+		"flash-erase-ahead", "flash-erase-ahead",
+		application_function_flash_erase_ahead,
+		(void *)0,
+	},
 	{
 		"flash-bench", "flash-bench",
 		application_function_flash_bench,
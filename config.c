@@ -36,6 +36,7 @@ roflash static const config_flag_name_t config_flag_names[] =
 	{	flag_log_to_display,		"log-to-display",			},
 	{	flag_ssd_height_32,			"ssd-height-32",			},
 	{	flag_pcf_no_poll,			"pcf-no-poll",				},
+	{	flag_sequencer_cache,		"sequencer-cache",			},
 	{	flag_none,					"",							},
 };
 
@@ -27,6 +27,7 @@ enum
 	flag_log_to_display =		1 << 18,
 	flag_ssd_height_32 =		1 << 19,
 	flag_pcf_no_poll =			1 << 20,
+	flag_sequencer_cache =		1 << 21,
 };
 
 void			config_flags_to_string(bool nl, const char *, string_t *);
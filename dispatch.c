@@ -13,6 +13,8 @@
 #include "config.h"
 #include "lwip-interface.h"
 #include "remote_trigger.h"
+#include "io_event.h"
+#include "ledpixel_effect.h"
 #include "ota.h"
 #include "font.h"
 #include "wlan.h"
@@ -474,6 +476,12 @@ drop:
 			break;
 		}
 
+		case(task_sequencer_cache_refill):
+		{
+			sequencer_cache_refill();
+			break;
+		}
+
 		case(task_alert_association):
 		{
 			if((assoc_alert.io >= 0) && (assoc_alert.pin >= 0))
@@ -496,6 +504,24 @@ drop:
 			break;
 		}
 
+		case(task_io_event_send):
+		{
+			io_event_send();
+			break;
+		}
+
+		case(task_rotary_encoder):
+		{
+			io_renc_process();
+			break;
+		}
+
+		case(task_ledpixel_effect):
+		{
+			ledpixel_effect_render();
+			break;
+		}
+
 		case(task_wlan_reconnect):
 		{
 			if(!wlan_reconnect())
@@ -527,6 +553,18 @@ drop:
 			break;
 		}
 
+		case(task_flash_checksum_worker):
+		{
+			flash_checksum_worker();
+			break;
+		}
+
+		case(task_flash_erase_ahead_worker):
+		{
+			flash_erase_ahead_worker();
+			break;
+		}
+
 		default:
 		{
 			log("[dispatch] invalid commmand in task\n");
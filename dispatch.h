@@ -43,6 +43,12 @@ typedef enum
 	task_pins_changed_mcp,
 	task_pins_changed_pcf,
 	task_display_load_picture_worker,
+	task_flash_checksum_worker,
+	task_flash_erase_ahead_worker,
+	task_io_event_send,
+	task_rotary_encoder,
+	task_ledpixel_effect,
+	task_sequencer_cache_refill,
 	task_invalid,
 	task_size = task_invalid,
 } task_id_t;
@@ -175,7 +175,6 @@ static void background_colour(unsigned int slot, unsigned int *r, unsigned int *
 static attr_result_used bool send_command_data(string_t *error, unsigned int send_cmd, unsigned int cmd, unsigned int length, const uint8_t *data)
 {
 	unsigned int current;
-	unsigned int value;
 
 	if(pin.dcx.enabled)
 	{
@@ -212,40 +211,28 @@ static attr_result_used bool send_command_data(string_t *error, unsigned int sen
 
 		if(length > 0)
 		{
-			if(!spi_start(error))
+			if(io_write_pin(error, pin.dcx.io, pin.dcx.pin, 1) != io_ok)
 			{
 				if(error)
-					string_append(error, " - during data start 8");
+					string_append(error, " - during data io 8");
 				return(false);
 			}
 
-			for(current = 0; current < length; current++)
-			{
-				value = data[current] & 0xff;
-
-				if(!spi_write(8, value))
-				{
-					if(error)
-						string_append(error, " - during data write 8");
-					return(false);
-				}
-			}
-
-			if(io_write_pin(error, pin.dcx.io, pin.dcx.pin, 1) != io_ok)
+			if(!spi_stream_begin(error, display.spispeed))
 			{
 				if(error)
-					string_append(error, " - during data io 8");
+					string_append(error, " - during data start 8");
 				return(false);
 			}
 
-			if(!spi_transmit(error, display.spispeed, 0, 0, 0, 0, 0, 0))
+			if(!spi_stream_bytes(error, length, data))
 			{
 				if(error)
-					string_append(error, " - during data transmit 8");
+					string_append(error, " - during data write 8");
 				return(false);
 			}
 
-			if(!spi_finish(error))
+			if(!spi_stream_end(error))
 			{
 				if(error)
 					string_append(error, " - during data finish 8");
@@ -255,18 +242,23 @@ static attr_result_used bool send_command_data(string_t *error, unsigned int sen
 	}
 	else
 	{
-		if(!spi_start(error))
+		if(!spi_stream_begin(error, display.spispeed))
 		{
 			if(error)
 				string_append(error, " - during start 9");
 			return(false);
 		}
 
-		for(current = 0; current < length; current++)
+		if(send_cmd && !spi_stream_write(error, 9, cmd))
 		{
-			value = data[current] | 0x100;
+			if(error)
+				string_append(error, " - during cmd write 9");
+			return(false);
+		}
 
-			if(!spi_write(9, value))
+		for(current = 0; current < length; current++)
+		{
+			if(!spi_stream_write(error, 9, data[current] | 0x100))
 			{
 				if(error)
 					string_append(error, " - during write 9");
@@ -274,14 +266,7 @@ static attr_result_used bool send_command_data(string_t *error, unsigned int sen
 			}
 		}
 
-		if(!spi_transmit(error, display.spispeed, send_cmd ? 9 : 0, cmd, 0, 0, 0, 0))
-		{
-			if(error)
-				string_append(error, " - during transmit 9");
-			return(false);
-		}
-
-		if(!spi_finish(error))
+		if(!spi_stream_end(error))
 		{
 			if(error)
 				string_append(error, " - during finish 9");
@@ -338,52 +323,6 @@ static attr_result_used bool write_spi_write_buffer(string_t *error)
 	return(true);
 }
 
-static attr_result_used bool output_data_8(string_t *error, unsigned int data)
-{
-	if(pin.dcx.enabled)
-	{
-		if(spi_write_bits_available() < 8)
-		{
-			if(!write_spi_write_buffer(error))
-			{
-				if(error)
-					string_append(error, "flush data");
-				return(false);
-			}
-		}
-
-		if(!spi_write(8, data))
-		{
-			if(error)
-				string_append(error, "spi write");
-			return(false);
-		}
-	}
-	else
-	{
-		data |= (1UL << 8);
-
-		if(spi_write_bits_available() < 9)
-		{
-			if(!write_spi_write_buffer(error))
-			{
-				if(error)
-					string_append(error, "flush data");
-				return(false);
-			}
-		}
-
-		if(!spi_write(9, data))
-		{
-			if(error)
-				string_append(error, "spi write");
-			return(false);
-		}
-	}
-
-	return(true);
-}
-
 static attr_result_used bool output_data_24(string_t *error, unsigned int data)
 {
 	if(pin.dcx.enabled)
@@ -434,8 +373,7 @@ static attr_result_used bool box(unsigned int r, unsigned int g, unsigned int b,
 {
 	string_new(, error, 64);
 	unsigned int box_colour;
-	unsigned int colour[3];
-	unsigned int pixels, bulk_pixel, bulk_stride, write_bits;
+	unsigned int pixels, fill_bits, fill_value;
 	unsigned int brightness;
 
 	if(pin.bright.enabled)
@@ -470,109 +408,35 @@ static attr_result_used bool box(unsigned int r, unsigned int g, unsigned int b,
 	box_colour = rgb_to_18bit_colour(r, g, b, brightness) & 0x00ffffff;
 	pixels = (to_x - from_x + 1) * (to_y - from_y + 1);
 
-	colour[0] = (box_colour & 0x00ff0000) >> 16;
-	colour[1] = (box_colour & 0x0000ff00) >> 8;
-	colour[2] = (box_colour & 0x000000ff) >> 0;
-	write_bits = 8;
-
-	if(!pin.dcx.enabled)
-	{
-		write_bits = 9;
-		colour[0] |= (1UL << 8);
-		colour[1] |= (1UL << 8);
-		colour[2] |= (1UL << 8);
-	}
-
-	if(!spi_start(&error))
+	if(pin.dcx.enabled)
 	{
-		log("spitft box: spi error 5: %s\n", string_to_cstr(&error));
-		return(false);
+		fill_bits = 24;
+		fill_value = box_colour;
 	}
-
-	for(bulk_stride = 0; bulk_stride < 256; bulk_stride++)
-	{
-		if(spi_write_bits_available() < (write_bits * 3))
-			break;
-
-		if(!spi_write(write_bits, colour[0]))
-		{
-			log("spitft box: spi error 6: spi write\n");
-			return(false);
-		}
-
-		if(!spi_write(write_bits, colour[1]))
-		{
-			log("spitft box: spi error 7: spi write\n");
-			return(false);
-		}
-
-		if(!spi_write(write_bits, colour[2]))
-		{
-			log("spitft box: spi error 8: spi write\n");
-			return(false);
-		}
-	}
-
-	if(bulk_stride >= 256)
+	else
 	{
-		log("spitft box: out of limits\n");
-		return(false);
+		fill_bits = 27;
+		fill_value = ((box_colour & 0x00ff0000) << 2) | ((box_colour & 0x0000ff00) << 1) | ((box_colour & 0x000000ff) << 0) | 0x4020100;
 	}
 
 	if(pin.dcx.enabled && (io_write_pin(&error, pin.dcx.io, pin.dcx.pin, 1) != io_ok))
 		return(false);
 
-	for(bulk_pixel = 0; (bulk_pixel + bulk_stride) < pixels; bulk_pixel += bulk_stride)
+	if(!spi_stream_begin(&error, display.spispeed))
 	{
-		if(!spi_transmit(&error, display.spispeed, 0, 0, 0, 0, 0, 0))
-		{
-			log("spitft box: spi error 9: %s\n", string_to_cstr(&error));
-			return(false);
-		}
-
-		if(!spi_finish(&error))
-		{
-			log("spitft box: spi error 10: %s\n", string_to_cstr(&error));
-			return(false);
-		}
-	}
-
-	if(!spi_start(&error))
-	{
-		log("spitft box: spi error 10: %s\n", string_to_cstr(&error));
+		log("spitft box: spi error 5: %s\n", string_to_cstr(&error));
 		return(false);
 	}
 
-	for(; bulk_pixel < pixels; bulk_pixel++)
-	{
-		if(!spi_write(write_bits, colour[0]))
-		{
-			log("spitft box: spi error 12: %s\n", string_to_cstr(&error));
-			return(false);
-		}
-
-		if(!spi_write(write_bits, colour[1]))
-		{
-			log("spitft box: spi error 13: spi_write\n");
-			return(false);
-		}
-
-		if(!spi_write(write_bits, colour[2]))
-		{
-			log("spitft box: spi error 14: spi_write\n");
-			return(false);
-		}
-	}
-
-	if(!spi_transmit(&error, display.spispeed, 0, 0, 0, 0, 0, 0))
+	if(!spi_stream_fill(&error, fill_bits, fill_value, pixels))
 	{
-		log("spitft box: spi error 15: %s\n", string_to_cstr(&error));
+		log("spitft box: spi error 6: %s\n", string_to_cstr(&error));
 		return(false);
 	}
 
-	if(!spi_finish(&error))
+	if(!spi_stream_end(&error))
 	{
-		log("spitft box: spi error 16: %s\n", string_to_cstr(&error));
+		log("spitft box: spi error 7: %s\n", string_to_cstr(&error));
 		return(false);
 	}
 
@@ -1092,7 +956,6 @@ static bool plot(unsigned int pixel_amount, int x, int y, string_t *pixels)
 {
 	enum { display_depth_bytes = 3 };
 	string_new(, error, 64);
-	int ix;
 
 	if(string_length(pixels) == 0)
 		return(true);
@@ -1128,11 +991,7 @@ static bool plot(unsigned int pixel_amount, int x, int y, string_t *pixels)
 
 	display.graphic_mode = 1;
 
-	for(ix = 0; ix < string_length(pixels); ix++)
-		if(!output_data_8((string_t *)0, string_at(pixels, ix)))
-			return(false);
-
-	if(!write_spi_write_buffer(&error))
+	if(!send_command_data(&error, false, 0, string_length(pixels), (const uint8_t *)string_buffer(pixels)))
 	{
 		log("spitft plot: %s\n", string_to_cstr(&error));
 		return(false);
@@ -864,6 +864,74 @@ enum
 	I2S_TX_CHAN_MOD_S =		0
 };
 
+enum
+{
+	REG_SLC_BASE =		0x60000b00,
+};
+
+enum
+{
+	SLC_CONF0 =				REG_SLC_BASE + 0x0000,
+	SLC_MODE =				0x00000003,
+	SLC_MODE_S =			12,
+	SLC_DATA_BURST_EN =		1 << 9,
+	SLC_DSCR_BURST_EN =		1 << 8,
+	SLC_RX_NO_RESTART_CLR =	1 << 7,
+	SLC_RX_AUTO_WRBACK =	1 << 6,
+	SLC_RX_LOOP_TEST =		1 << 5,
+	SLC_TX_LOOP_TEST =		1 << 4,
+	SLC_AHBM_RST =			1 << 3,
+	SLC_AHBM_FIFO_RST =		1 << 2,
+	SLC_RXLINK_RST =		1 << 1,
+	SLC_TXLINK_RST =		1 << 0,
+};
+
+enum
+{
+	SLC_INT_RAW =				REG_SLC_BASE + 0x0004,
+	SLC_INT_STATUS =			REG_SLC_BASE + 0x0008,
+	SLC_INT_ENA =				REG_SLC_BASE + 0x000c,
+	SLC_INT_CLR =				REG_SLC_BASE + 0x0010,
+	SLC_TX_DSCR_EMPTY_INT =		1 << 21,
+	SLC_RX_DSCR_ERR_INT =		1 << 20,
+	SLC_TX_DSCR_ERR_INT =		1 << 19,
+	SLC_TOHOST_INT =			1 << 18,
+	SLC_RX_EOF_INT =			1 << 17,
+	SLC_RX_DONE_INT =			1 << 16,
+	SLC_TX_EOF_INT =			1 << 15,
+	SLC_TX_DONE_INT =			1 << 14,
+};
+
+enum
+{
+	SLC_RX_LINK =				REG_SLC_BASE + 0x0024, // slc "rx" feeds the i2s transmitter
+	SLC_RXLINK_PARK =			1UL << 31,
+	SLC_RXLINK_RESTART =		1 << 30,
+	SLC_RXLINK_START =			1 << 29,
+	SLC_RXLINK_STOP =			1 << 28,
+	SLC_RXLINK_DESCADDR_MASK =	0x000fffff,
+};
+
+enum
+{
+	SLC_TX_LINK =				REG_SLC_BASE + 0x0028,
+	SLC_TXLINK_PARK =			1UL << 31,
+	SLC_TXLINK_RESTART =		1 << 30,
+	SLC_TXLINK_START =			1 << 29,
+	SLC_TXLINK_STOP =			1 << 28,
+	SLC_TXLINK_DESCADDR_MASK =	0x000fffff,
+};
+
+enum
+{
+	SLC_RX_DSCR_CONF =		REG_SLC_BASE + 0x0090,
+	SLC_RX_FILL_EN =		1 << 20,
+	SLC_RX_EOF_MODE =		1 << 19,
+	SLC_RX_FILL_MODE =		1 << 18,
+	SLC_INFOR_NO_REPLACE =	1 << 9,
+	SLC_TOKEN_NO_REPLACE =	1 << 8,
+};
+
 void rom_i2c_writeReg(uint8_t block, uint8_t host_id, uint8_t reg_add, uint8_t data);
 
 #endif
@@ -0,0 +1,379 @@
+#include "flash-emulator.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// this mirrors the layout in the "flashmap" file, use the same defines as the firmware (see Makefile)
+
+static const flash_emu_region_t flash_emu_regions[] =
+{
+	{	"rboot boot",			OFFSET_BOOT,				SIZE_BOOT				},
+	{	"rboot config",			OFFSET_RBOOT_CFG,			SIZE_RBOOT_CFG			},
+	{	"image slot #0",		OFFSET_IMG_0,				SIZE_IMG				},
+	{	"font #0",				FONT_FLASH_OFFSET_0,		FONT_FLASH_SIZE			},
+	{	"sequencer #0",			SEQUENCER_FLASH_OFFSET_0,	SEQUENCER_FLASH_SIZE	},
+	{	"user config",			USER_CONFIG_OFFSET,			USER_CONFIG_SIZE		},
+	{	"rf calibration",		RFCAL_OFFSET,				RFCAL_SIZE				},
+	{	"image slot #1",		OFFSET_IMG_1,				SIZE_IMG				},
+	{	"font #1",				FONT_FLASH_OFFSET_1,		FONT_FLASH_SIZE			},
+	{	"sequencer #1",			SEQUENCER_FLASH_OFFSET_1,	SEQUENCER_FLASH_SIZE	},
+	{	"rf defaults",			PHYDATA_OFFSET,				PHYDATA_SIZE			},
+	{	"system config",		SYSTEM_CONFIG_OFFSET,		SYSTEM_CONFIG_SIZE		},
+	{	"picture #0",			PICTURE_FLASH_OFFSET_0,		PICTURE_FLASH_SIZE		},
+	{	"picture #1",			PICTURE_FLASH_OFFSET_1,		PICTURE_FLASH_SIZE		},
+	{	"misc",					MISC_FLASH_OFFSET,			MISC_FLASH_SIZE			},
+	{	(const char *)0,		0,							0						},
+};
+
+// typical values for a W25Q32 class device
+
+static const flash_emu_timing_t flash_emu_timing_default =
+{
+	.read_setup_ns =	2000,
+	.read_byte_ns =		50,
+	.write_page_ns =	700000,
+	.write_byte_ns =	50,
+	.erase_sector_ns =	45000000,
+};
+
+typedef struct
+{
+	int					fd;
+	uint8_t				*image;
+	unsigned int		flags;
+	unsigned int		slot;
+	flash_emu_timing_t	timing;
+	flash_emu_stats_t	stats;
+	unsigned int		erase_count[flash_emu_sectors];
+} flash_emu_t;
+
+static flash_emu_t flash_emu =
+{
+	.fd = -1,
+	.image = (uint8_t *)0,
+};
+
+static void flash_emu_spend(uint64_t ns)
+{
+	struct timespec ts;
+
+	flash_emu.stats.time_ns += ns;
+
+	if(flash_emu.flags & flash_emu_flag_realtime)
+	{
+		ts.tv_sec = ns / 1000000000ULL;
+		ts.tv_nsec = ns % 1000000000ULL;
+
+		while(nanosleep(&ts, &ts) && (errno == EINTR))
+			;
+	}
+}
+
+static bool flash_emu_check(const char *op, uint32_t offset, uint32_t length, bool aligned)
+{
+	if(!flash_emu.image)
+	{
+		fprintf(stderr, "flash emulator: %s: not opened\n", op);
+		goto error;
+	}
+
+	if((offset >= flash_emu_size) || (length > (flash_emu_size - offset)))
+	{
+		fprintf(stderr, "flash emulator: %s: out of range: 0x%06x/%u\n", op, offset, length);
+		goto error;
+	}
+
+	if(aligned && (((offset % 4) != 0) || ((length % 4) != 0)))
+	{
+		fprintf(stderr, "flash emulator: %s: unaligned: 0x%06x/%u\n", op, offset, length);
+		goto error;
+	}
+
+	return(true);
+
+error:
+	flash_emu.stats.errors++;
+	return(false);
+}
+
+bool flash_emu_open(const char *image_file, unsigned int flags)
+{
+	struct stat st;
+	uint8_t *blank;
+	int open_flags;
+
+	if(flash_emu.image)
+		flash_emu_close();
+
+	memset(&flash_emu.stats, 0, sizeof(flash_emu.stats));
+	memset(flash_emu.erase_count, 0, sizeof(flash_emu.erase_count));
+
+	flash_emu.flags = flags;
+	flash_emu.slot = 0;
+	flash_emu.timing = flash_emu_timing_default;
+
+	open_flags = (flags & flash_emu_flag_readonly) ? O_RDONLY : (O_RDWR | O_CREAT);
+
+	if((flash_emu.fd = open(image_file, open_flags, 0644)) < 0)
+	{
+		fprintf(stderr, "flash emulator: open %s: %s\n", image_file, strerror(errno));
+		return(false);
+	}
+
+	if(fstat(flash_emu.fd, &st))
+	{
+		fprintf(stderr, "flash emulator: stat %s: %s\n", image_file, strerror(errno));
+		goto error;
+	}
+
+	// a new or short image is padded with erased sectors
+
+	if(!(flags & flash_emu_flag_readonly) && (st.st_size < flash_emu_size))
+	{
+		if(!(blank = malloc(flash_emu_size - st.st_size)))
+			goto error;
+
+		memset(blank, 0xff, flash_emu_size - st.st_size);
+
+		if(pwrite(flash_emu.fd, blank, flash_emu_size - st.st_size, st.st_size) != (ssize_t)(flash_emu_size - st.st_size))
+		{
+			fprintf(stderr, "flash emulator: extend %s: %s\n", image_file, strerror(errno));
+			free(blank);
+			goto error;
+		}
+
+		free(blank);
+	}
+	else
+	{
+		if(st.st_size < flash_emu_size)
+		{
+			fprintf(stderr, "flash emulator: %s: image too small: %lld\n", image_file, (long long)st.st_size);
+			goto error;
+		}
+	}
+
+	// a private mapping keeps the image file untouched in read-only mode, while still allowing writes to the emulated flash
+
+	flash_emu.image = mmap((void *)0, flash_emu_size, PROT_READ | PROT_WRITE,
+			(flags & flash_emu_flag_readonly) ? MAP_PRIVATE : MAP_SHARED, flash_emu.fd, 0);
+
+	if(flash_emu.image == MAP_FAILED)
+	{
+		fprintf(stderr, "flash emulator: mmap %s: %s\n", image_file, strerror(errno));
+		flash_emu.image = (uint8_t *)0;
+		goto error;
+	}
+
+	return(true);
+
+error:
+	close(flash_emu.fd);
+	flash_emu.fd = -1;
+	return(false);
+}
+
+void flash_emu_close(void)
+{
+	if(flash_emu.image)
+	{
+		if(!(flash_emu.flags & flash_emu_flag_readonly))
+			msync(flash_emu.image, flash_emu_size, MS_SYNC);
+
+		munmap(flash_emu.image, flash_emu_size);
+		flash_emu.image = (uint8_t *)0;
+	}
+
+	if(flash_emu.fd >= 0)
+	{
+		close(flash_emu.fd);
+		flash_emu.fd = -1;
+	}
+}
+
+void flash_emu_set_timing(const flash_emu_timing_t *timing)
+{
+	flash_emu.timing = *timing;
+}
+
+void flash_emu_get_timing(flash_emu_timing_t *timing)
+{
+	*timing = flash_emu.timing;
+}
+
+void flash_emu_select_slot(unsigned int slot)
+{
+	flash_emu.slot = slot;
+}
+
+uint8_t *flash_emu_image(void)
+{
+	return(flash_emu.image);
+}
+
+unsigned int flash_emu_erase_count(unsigned int sector)
+{
+	if(sector >= flash_emu_sectors)
+		return(0);
+
+	return(flash_emu.erase_count[sector]);
+}
+
+void flash_emu_get_stats(flash_emu_stats_t *stats)
+{
+	*stats = flash_emu.stats;
+}
+
+void flash_emu_reset_stats(void)
+{
+	memset(&flash_emu.stats, 0, sizeof(flash_emu.stats));
+}
+
+const flash_emu_region_t *flash_emu_region_lookup(uint32_t offset)
+{
+	const flash_emu_region_t *region;
+
+	for(region = flash_emu_regions; region->name; region++)
+		if((offset >= region->offset) && (offset < (region->offset + region->size)))
+			return(region);
+
+	return((const flash_emu_region_t *)0);
+}
+
+void flash_emu_dump_stats(FILE *fp)
+{
+	const flash_emu_region_t *region;
+	unsigned int sector, first, last, erases, max;
+
+	fprintf(fp, "reads: %u (%llu bytes), writes: %u (%llu bytes), erases: %u\n",
+			flash_emu.stats.reads, (unsigned long long)flash_emu.stats.bytes_read,
+			flash_emu.stats.writes, (unsigned long long)flash_emu.stats.bytes_written,
+			flash_emu.stats.erases);
+	fprintf(fp, "write violations: %u, writes skipped: %u, errors: %u\n",
+			flash_emu.stats.write_violations, flash_emu.stats.write_skipped, flash_emu.stats.errors);
+	fprintf(fp, "simulated time: %llu us\n", (unsigned long long)(flash_emu.stats.time_ns / 1000));
+
+	for(region = flash_emu_regions; region->name; region++)
+	{
+		first = region->offset / SPI_FLASH_SEC_SIZE;
+		last = (region->offset + region->size) / SPI_FLASH_SEC_SIZE;
+
+		for(sector = first, erases = 0, max = 0; sector < last; sector++)
+		{
+			erases += flash_emu.erase_count[sector];
+
+			if(flash_emu.erase_count[sector] > max)
+				max = flash_emu.erase_count[sector];
+		}
+
+		if(erases > 0)
+			fprintf(fp, "%-16s 0x%06x-0x%06x: erases total: %u, max per sector: %u\n",
+					region->name, region->offset, region->offset + region->size - 1, erases, max);
+	}
+}
+
+SpiFlashOpResult spi_flash_erase_sector(uint16_t sector)
+{
+	if(!flash_emu_check("erase", sector * SPI_FLASH_SEC_SIZE, SPI_FLASH_SEC_SIZE, true))
+		return(SPI_FLASH_RESULT_ERR);
+
+	if(flash_emu.flags & flash_emu_flag_verbose)
+		fprintf(stderr, "flash emulator: erase sector 0x%03x\n", sector);
+
+	memset(flash_emu.image + (sector * SPI_FLASH_SEC_SIZE), 0xff, SPI_FLASH_SEC_SIZE);
+
+	flash_emu.erase_count[sector]++;
+	flash_emu.stats.erases++;
+	flash_emu_spend(flash_emu.timing.erase_sector_ns);
+
+	return(SPI_FLASH_RESULT_OK);
+}
+
+SpiFlashOpResult spi_flash_write(uint32_t offset, const void *src_void, uint32_t length)
+{
+	const uint8_t *src = (const uint8_t *)src_void;
+	uint8_t *dst;
+	unsigned int current, pages;
+	bool violation, blank;
+
+	if(!flash_emu_check("write", offset, length, true))
+		return(SPI_FLASH_RESULT_ERR);
+
+	if(flash_emu.flags & flash_emu_flag_verbose)
+		fprintf(stderr, "flash emulator: write 0x%06x/%u\n", offset, length);
+
+	dst = flash_emu.image + offset;
+
+	for(current = 0, violation = false, blank = true; current < length; current++)
+	{
+		if(src[current] & ~dst[current])
+			violation = true;
+
+		if(src[current] != 0xff)
+			blank = false;
+	}
+
+	if(violation)
+	{
+		flash_emu.stats.write_violations++;
+
+		if(flash_emu.flags & flash_emu_flag_strict)
+		{
+			fprintf(stderr, "flash emulator: write 0x%06x/%u: setting bits without erase\n", offset, length);
+			flash_emu.stats.errors++;
+			return(SPI_FLASH_RESULT_ERR);
+		}
+	}
+
+	if(blank)
+		flash_emu.stats.write_skipped++;
+
+	// NOR flash: programming can only clear bits
+
+	for(current = 0; current < length; current++)
+		dst[current] &= src[current];
+
+	pages = ((offset + length + flash_emu_page_size - 1) / flash_emu_page_size) - (offset / flash_emu_page_size);
+
+	flash_emu.stats.writes++;
+	flash_emu.stats.bytes_written += length;
+	flash_emu_spend(((uint64_t)pages * flash_emu.timing.write_page_ns) + ((uint64_t)length * flash_emu.timing.write_byte_ns));
+
+	return(SPI_FLASH_RESULT_OK);
+}
+
+SpiFlashOpResult spi_flash_read(uint32_t offset, void *dst, uint32_t length)
+{
+	if(!flash_emu_check("read", offset, length, true))
+		return(SPI_FLASH_RESULT_ERR);
+
+	if(flash_emu.flags & flash_emu_flag_verbose)
+		fprintf(stderr, "flash emulator: read 0x%06x/%u\n", offset, length);
+
+	memcpy(dst, flash_emu.image + offset, length);
+
+	flash_emu.stats.reads++;
+	flash_emu.stats.bytes_read += length;
+	flash_emu_spend(flash_emu.timing.read_setup_ns + ((uint64_t)length * flash_emu.timing.read_byte_ns));
+
+	return(SPI_FLASH_RESULT_OK);
+}
+
+// equivalent of the 1 Mbyte flash window at 0x40200000, as mapped by rboot for the current slot
+
+const void *flash_cache_pointer(uint32_t offset)
+{
+	if(!flash_emu.image || (offset >= flash_emu_mapped_window_size))
+		return((const void *)0);
+
+	return(flash_emu.image + (flash_emu.slot * flash_emu_mapped_window_size) + offset);
+}
@@ -0,0 +1,90 @@
+#ifndef flash_emulator_h
+#define flash_emulator_h
+
+// Host-side (Linux) emulation of the SPI flash, for running and benchmarking
+// the storage code (config, sequencer, font, picture) off-device.
+// When used together with sdk.h, include sdk.h first.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#ifndef _sdk_h_
+enum
+{
+	SPI_FLASH_SEC_SIZE = 4096,
+};
+
+typedef enum
+{
+	SPI_FLASH_RESULT_OK,
+	SPI_FLASH_RESULT_ERR,
+	SPI_FLASH_RESULT_TIMEOUT,
+} SpiFlashOpResult;
+
+SpiFlashOpResult	spi_flash_erase_sector(uint16_t);
+SpiFlashOpResult	spi_flash_write(uint32_t, const void *, uint32_t);
+SpiFlashOpResult	spi_flash_read(uint32_t, void *, uint32_t);
+#endif
+
+const void *flash_cache_pointer(uint32_t offset);
+
+enum
+{
+	flash_emu_size = 0x400000,
+	flash_emu_sectors = flash_emu_size / SPI_FLASH_SEC_SIZE,
+	flash_emu_page_size = 256,
+	flash_emu_mapped_window_size = 0x100000,
+};
+
+typedef enum
+{
+	flash_emu_flag_none =		0 << 0,
+	flash_emu_flag_strict =		1 << 0,	// writes that try to set bits (0 -> 1) fail instead of being ANDed silently
+	flash_emu_flag_realtime =	1 << 1,	// actually sleep for the simulated duration of each operation
+	flash_emu_flag_readonly =	1 << 2,	// don't write changes back to the image file
+	flash_emu_flag_verbose =	1 << 3,	// log every operation to stderr
+} flash_emu_flag_t;
+
+typedef struct
+{
+	unsigned int read_setup_ns;		// command + address + dummy cycles
+	unsigned int read_byte_ns;		// per byte (QIO @ 40 MHz ~ 50 ns)
+	unsigned int write_page_ns;		// page program, per started 256 byte page
+	unsigned int write_byte_ns;		// data transfer for page program, per byte
+	unsigned int erase_sector_ns;	// 4k sector erase
+} flash_emu_timing_t;
+
+typedef struct
+{
+	unsigned int	reads;
+	unsigned int	writes;
+	unsigned int	erases;
+	uint64_t		bytes_read;
+	uint64_t		bytes_written;
+	unsigned int	write_violations;	// writes that tried to set bits without preceding erase
+	unsigned int	write_skipped;		// writes of all-0xff data, no-ops on NOR
+	unsigned int	errors;				// out of range, unaligned, strict violations
+	uint64_t		time_ns;			// accumulated simulated time
+} flash_emu_stats_t;
+
+typedef struct
+{
+	const char *name;
+	uint32_t	offset;
+	uint32_t	size;
+} flash_emu_region_t;
+
+bool		flash_emu_open(const char *image_file, unsigned int flags);
+void		flash_emu_close(void);
+void		flash_emu_set_timing(const flash_emu_timing_t *timing);
+void		flash_emu_get_timing(flash_emu_timing_t *timing);
+void		flash_emu_select_slot(unsigned int slot);
+uint8_t *	flash_emu_image(void);
+unsigned int flash_emu_erase_count(unsigned int sector);
+void		flash_emu_get_stats(flash_emu_stats_t *stats);
+void		flash_emu_reset_stats(void);
+const flash_emu_region_t *flash_emu_region_lookup(uint32_t offset);
+void		flash_emu_dump_stats(FILE *fp);
+
+#endif
@@ -0,0 +1,174 @@
+#include "attribute.h"
+#include "gamma.h"
+#include "config.h"
+
+
+// Gamma tables are built from config at boot (and on change), one for
+// ledpixels (8 bit in, 8.8 fixed point out, so the fraction can be dithered
+// over successive frames) and one for pwm outputs (257 points, 16 bit out,
+// interpolated for any pwm width).
+
+typedef struct
+{
+	unsigned int	ledpixel;
+	unsigned int	pwm;
+	bool			dither;
+	uint16_t		ledpixel_table[256];
+	uint16_t		pwm_table[257];
+} gamma_t;
+
+static gamma_t gamma_state;
+
+roflash static const char gamma_key_ledpixel[] = "gamma.ledpixel";
+roflash static const char gamma_key_pwm[] = "gamma.pwm";
+roflash static const char gamma_key_dither[] = "gamma.dither";
+
+static unsigned int gamma_load(const char *key_flash)
+{
+	unsigned int value;
+
+	if(!config_get_uint_flashptr(key_flash, &value, -1, -1) || (value < gamma_linear) || (value > gamma_max))
+		value = gamma_linear;
+
+	return(value);
+}
+
+void gamma_init(void)
+{
+	unsigned int ix, dither;
+	double exponent;
+
+	gamma_state.ledpixel = gamma_load(gamma_key_ledpixel);
+	gamma_state.pwm = gamma_load(gamma_key_pwm);
+
+	if(!config_get_uint_flashptr(gamma_key_dither, &dither, -1, -1))
+		dither = 0;
+
+	gamma_state.dither = !!dither;
+
+	if(gamma_state.ledpixel != gamma_linear)
+	{
+		exponent = gamma_state.ledpixel / 10.0;
+
+		for(ix = 0; ix < 256; ix++)
+			gamma_state.ledpixel_table[ix] = (uint16_t)((pow(ix / 255.0, exponent) * 255.0 * 256.0) + 0.5);
+	}
+
+	if(gamma_state.pwm != gamma_linear)
+	{
+		exponent = gamma_state.pwm / 10.0;
+
+		for(ix = 0; ix < 257; ix++)
+			gamma_state.pwm_table[ix] = (uint16_t)((pow(ix / 256.0, exponent) * 65535.0) + 0.5);
+	}
+}
+
+bool gamma_ledpixel_active(void)
+{
+	return(gamma_state.ledpixel != gamma_linear);
+}
+
+bool gamma_dither(void)
+{
+	return(gamma_state.dither && (gamma_state.ledpixel != gamma_linear));
+}
+
+unsigned int gamma_ledpixel(unsigned int value)
+{
+	if(gamma_state.ledpixel == gamma_linear)
+		return((value & 0xff) << 8);
+
+	return(gamma_state.ledpixel_table[value & 0xff]);
+}
+
+bool gamma_pwm_active(void)
+{
+	return(gamma_state.pwm != gamma_linear);
+}
+
+unsigned int gamma_pwm(unsigned int value, unsigned int period)
+{
+	unsigned int position, index, fraction, level, result;
+
+	if((gamma_state.pwm == gamma_linear) || (period < 2))
+		return(value);
+
+	if(value >= period)
+		value = period - 1;
+
+	position = (unsigned int)(((uint64_t)value << 16) / (period - 1));
+	index = position >> 8;
+	fraction = position & 0xff;
+
+	if(index >= 256)
+		level = gamma_state.pwm_table[256];
+	else
+		level = gamma_state.pwm_table[index] + (((gamma_state.pwm_table[index + 1] - gamma_state.pwm_table[index]) * fraction) >> 8);
+
+	result = (unsigned int)((((uint64_t)level * (period - 1)) + 32768) >> 16);
+
+	// keep the output on when it's on
+
+	if((value > 0) && (result == 0))
+		result = 1;
+
+	return(result);
+}
+
+app_action_t application_function_gamma(app_params_t *parameters)
+{
+	string_new(, type, 16);
+	unsigned int value, value_default;
+	const char *key_flash;
+
+	if(parse_string(1, parameters->src, &type, ' ') == parse_ok)
+	{
+		key_flash = (const char *)0;
+		value_default = gamma_linear;
+
+		if(string_match_cstr(&type, "ledpixel"))
+			key_flash = gamma_key_ledpixel;
+		else if(string_match_cstr(&type, "pwm"))
+			key_flash = gamma_key_pwm;
+		else if(string_match_cstr(&type, "dither"))
+		{
+			key_flash = gamma_key_dither;
+			value_default = 0;
+		}
+
+		if(!key_flash || (parse_uint(2, parameters->src, &value, 0, ' ') != parse_ok) ||
+				((key_flash == gamma_key_dither) ? (value > 1) : ((value < gamma_linear) || (value > gamma_max))))
+		{
+			string_format(parameters->dst, "> usage: gamma [ledpixel|pwm <gamma * 10, %u (linear) - %u> | dither <0|1>]\n", gamma_linear, gamma_max);
+			return(app_action_error);
+		}
+
+		if(!config_open_write())
+		{
+			string_append(parameters->dst, "> cannot set config (open)\n");
+			return(app_action_error);
+		}
+
+		config_delete_flashptr(key_flash, false, -1, -1);
+
+		if((value != value_default) && !config_set_uint_flashptr(key_flash, value, -1, -1))
+		{
+			config_abort_write();
+			string_append(parameters->dst, "> cannot set config\n");
+			return(app_action_error);
+		}
+
+		if(!config_close_write())
+		{
+			string_append(parameters->dst, "> cannot set config (close)\n");
+			return(app_action_error);
+		}
+
+		gamma_init();
+	}
+
+	string_format(parameters->dst, "> gamma ledpixel: %u.%u, pwm: %u.%u, dither: %s\n",
+			gamma_state.ledpixel / 10, gamma_state.ledpixel % 10, gamma_state.pwm / 10, gamma_state.pwm % 10, gamma_state.dither ? "on" : "off");
+
+	return(app_action_normal);
+}
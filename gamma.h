@@ -0,0 +1,25 @@
+#ifndef _gamma_h_
+#define _gamma_h_
+
+#include "util.h"
+#include "dispatch.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+enum
+{
+	gamma_linear = 10,	// gamma is configured in tenths
+	gamma_max = 40,
+};
+
+void			gamma_init(void);
+bool			gamma_ledpixel_active(void);
+bool			gamma_dither(void);
+unsigned int	gamma_ledpixel(unsigned int value);
+bool			gamma_pwm_active(void);
+unsigned int	gamma_pwm(unsigned int value, unsigned int period);
+
+app_action_t application_function_gamma(app_params_t *);
+
+#endif
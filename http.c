@@ -405,7 +405,7 @@ static app_action_t handler_sensors(const string_t *src, string_t *dst)
 			if(i2c_sensor_registered(bus, sensor))
 			{
 				string_append(dst, "<tr><td>");
-				i2c_sensor_read(dst, bus, sensor, false, true);
+				i2c_sensor_read(dst, bus, sensor, i2c_sensor_max_age_auto, false, true);
 				string_append(dst, "</td></tr>\n");
 				detected++;
 			}
@@ -19,46 +19,29 @@ _Static_assert(sizeof(i2c_direction_t) == 4, "sizeof(i2c_direction_t) != 4");
 
 typedef enum
 {
-	i2c_config_scl_wait_cycles = 14000,
-	i2c_config_sda_wait_cycles = 10,
+	i2c_config_stretch_timeout_us = 25000,	// SMBus clock low timeout
+	i2c_config_sda_wait_half_bits = 10,
 	i2c_config_sda_reset_cycles = 32,
+	i2c_config_measure_runs = 16,
+	i2c_config_measure_half_bits = 24,		// start (3) + address and ACK (18) + stop (3)
 } i2c_config_t;
 
-typedef enum
-{
-	i2c_delay_send_bit_scl_low = 0,
-	i2c_delay_send_bit_scl_high,
-	i2c_delay_receive_bit_scl_low,
-	i2c_delay_receive_bit_scl_high,
-	i2c_delay_fixup_pre_wait,
-	i2c_delay_fixup_cycle_phase,
-	i2c_delay_fixup_post_wait,
-	i2c_delay_send_start_stop_scl_low,
-	i2c_delay_send_start_stop_scl_high_1,
-	i2c_delay_send_start_stop_scl_high_2,
-	i2c_delay_size,
-} i2c_delay_enum_t;
+// The bus is paced by ccount deadlines instead of fixed delays. Each half of an
+// SCL period ends at a deadline precomputed from the previous one, so the time
+// spent in the code itself, including gpio access, is absorbed instead of
+// added to the delay. A half bit that took too long (interrupt, clock
+// stretching) moves the deadline forward, it's never shortened to catch up.
 
 typedef struct
 {
-	unsigned int			delay;
-	const unsigned int		factor_slow;
-	const unsigned int		factor_fast;
-} i2c_delay_t;
-
-static i2c_delay_t i2c_delay[i2c_delay_size] =
-{
-	{	i2c_delay_send_bit_scl_low,				96,		288		},
-	{	i2c_delay_send_bit_scl_high,			280,	690		},
-	{	i2c_delay_receive_bit_scl_low,			124,	320		},
-	{	i2c_delay_receive_bit_scl_high,			232,	630		},
-	{	i2c_delay_fixup_pre_wait,				500,	1332	},
-	{	i2c_delay_fixup_cycle_phase,			250,	664		},
-	{	i2c_delay_fixup_post_wait,				250,	664		},
-	{	i2c_delay_send_start_stop_scl_low,		100,	294		},
-	{	i2c_delay_send_start_stop_scl_high_1,	100,	340		},
-	{	i2c_delay_send_start_stop_scl_high_2,	60,		210		},
-};
+	uint32_t		half_bit;			// cycles
+	uint32_t		stretch_timeout;	// cycles
+	uint32_t		deadline;
+	unsigned int	cpu_mhz;
+	unsigned int	speed_delay;
+} i2c_timing_t;
+
+static i2c_timing_t timing;
 
 struct
 {
@@ -114,6 +97,7 @@ static roflash const char roflash_error_strings[i2c_error_size + 1][32] =
 	"in use",
 	"in use on bus 0",
 	"overflow",
+	"timeout",
 	"error",
 };
 
@@ -162,87 +146,84 @@ attr_inline bool scl_is_high(void)
 	return(gpio_get(scl_pin));
 }
 
-attr_inline void delay(i2c_delay_enum_t delay_index)
+attr_inline void deadline_start(void)
 {
-	csleep(i2c_delay[delay_index].delay);
+	timing.deadline = ccount();
 }
 
-iram static i2c_error_t sda_set_test(bool val, i2c_delay_enum_t delay_index)
+attr_inline void deadline_wait(void)
 {
-	unsigned int current = i2c_config_sda_wait_cycles;
-	unsigned int wait_cycles = 0;
+	uint32_t now;
 
-	if(val)
-	{
-		for(sda_high(); current > 0; current--, wait_cycles++)
-		{
-			delay(delay_index);
+	timing.deadline += timing.half_bit;
+	now = ccount();
 
-			if(sda_is_high())
-				break;
-		}
-	}
-	else
+	// overrun (e.g. an interrupt), restart from now and still wait a full half, never shorten it
+
+	if((int32_t)(now - timing.deadline) >= 0)
+		timing.deadline = now + timing.half_bit;
+
+	while((int32_t)(ccount() - timing.deadline) < 0);
+}
+
+iram static i2c_error_t scl_release(void)
+{
+	uint32_t start, waited;
+
+	scl_high();
+
+	if(scl_is_high())
+		return(i2c_error_ok);
+
+	// slave is stretching the clock (or the line is still rising), the high half starts when it's released
+
+	for(start = ccount(); scl_is_low(); )
 	{
-		for(sda_low(); current > 0; current--, wait_cycles++)
+		if((waited = ccount() - start) > timing.stretch_timeout)
 		{
-			delay(delay_index);
-
-			if(sda_is_low())
-				break;
+			stat_i2c_bus_locks++;
+			stat_i2c_bus_lock_max_period = umax(stat_i2c_bus_lock_max_period, waited / timing.cpu_mhz);
+			log("scl release: bus still locked after %u us, giving up\n", waited / timing.cpu_mhz);
+			return(i2c_error_bus_lock);
 		}
 	}
 
-	if(wait_cycles == 0)
-		return(i2c_error_ok);
+	waited = ccount() - start;
 
-	stat_i2c_sda_stucks++;
-	stat_i2c_sda_stuck_max_period = umax(stat_i2c_sda_stuck_max_period, wait_cycles);
+	if(waited > timing.half_bit)
+	{
+		stat_i2c_clock_stretches++;
+		stat_i2c_clock_stretch_max_us = umax(stat_i2c_clock_stretch_max_us, waited / timing.cpu_mhz);
+	}
 
-	if(current > 0)
-		return(i2c_error_ok);
+	deadline_start();
 
-	log("sda set test: sda still stuck after %u cycles, giving up\n", wait_cycles);
-	return(i2c_error_sda_stuck);
+	return(i2c_error_ok);
 }
 
-iram static i2c_error_t scl_set_test(bool val, i2c_delay_enum_t delay_index)
+iram static i2c_error_t sda_wait_high(void)
 {
-	unsigned int current = i2c_config_scl_wait_cycles;
-	unsigned int wait_cycles = 0;
+	unsigned int wait_half_bits;
 
-	if(val)
+	for(wait_half_bits = 0; sda_is_low(); wait_half_bits++)
 	{
-		for(scl_high(); current > 0; current--, wait_cycles++)
+		if(wait_half_bits >= i2c_config_sda_wait_half_bits)
 		{
-			delay(delay_index);
-
-			if(scl_is_high())
-				break;
+			stat_i2c_sda_stucks++;
+			log("sda wait high: sda still stuck after %u half bits, giving up\n", wait_half_bits);
+			return(i2c_error_sda_stuck);
 		}
-	}
-	else
-	{
-		for(scl_low(); current > 0; current--, wait_cycles++)
-		{
-			delay(delay_index);
 
-			if(scl_is_low())
-				break;
-		}
+		deadline_wait();
 	}
 
-	if(wait_cycles == 0)
-		return(i2c_error_ok);
-
-	stat_i2c_bus_locks++;
-	stat_i2c_bus_lock_max_period = umax(stat_i2c_bus_lock_max_period, wait_cycles);
-
-	if(current > 0)
-		return(i2c_error_ok);
+	if(wait_half_bits > 0)
+	{
+		stat_i2c_sda_stucks++;
+		stat_i2c_sda_stuck_max_period = umax(stat_i2c_sda_stuck_max_period, wait_half_bits);
+	}
 
-	log("scl set test: bus still locked after %u cycles, giving up\n", wait_cycles);
-	return(i2c_error_bus_lock);
+	return(i2c_error_ok);
 }
 
 iram static i2c_error_t send_bit(bool bit)
@@ -250,25 +231,24 @@ iram static i2c_error_t send_bit(bool bit)
 	i2c_error_t error;
 
 	// at this point SCL should be high and sda will be unknown
-	// wait for SCL to be released by slave (clock stretching)
 
-	if((error = scl_set_test(false, i2c_delay_send_bit_scl_low)) != i2c_error_ok)
-	{
-		log("\nsend_bit 1\n");
-		return(error);
-	}
+	scl_low();
+	deadline_start();
 
-	if((error = sda_set_test(bit, i2c_delay_send_bit_scl_low)) != i2c_error_ok)
-	{
-		log("\nsend_bit 2\n");
+	if(bit)
+		sda_high();
+	else
+		sda_low();
+
+	deadline_wait();
+
+	if(bit && ((error = sda_wait_high()) != i2c_error_ok))
 		return(error);
-	}
 
-	if((error = scl_set_test(true, i2c_delay_send_bit_scl_high)) != i2c_error_ok)
-	{
-		log("send-bit 3\n");
+	if((error = scl_release()) != i2c_error_ok)
 		return(error);
-	}
+
+	deadline_wait();
 
 	return(i2c_error_ok);
 }
@@ -278,26 +258,25 @@ iram static i2c_error_t receive_bit(bool *bit)
 	i2c_error_t error;
 
 	// at this point SCL should be high and sda will be unknown
-	// wait for SCL to be released by slave (clock stretching)
 
 	if(state == i2c_state_idle)
 		return(i2c_error_invalid_state_idle);
 
 	// make sure SDA is off so slave can pull it
 	// do it while SCL is pulled
-
-	if((error = scl_set_test(false, i2c_delay_receive_bit_scl_low)) != i2c_error_ok)
-		return(error);
-
-	delay(i2c_delay_receive_bit_scl_low);
-
 	// don't check SDA here, because the slave might already have pulled it low, which is OK
 
+	scl_low();
+	deadline_start();
 	sda_high();
 
-	if((error = scl_set_test(true, i2c_delay_receive_bit_scl_high)) != i2c_error_ok)
+	deadline_wait();
+
+	if((error = scl_release()) != i2c_error_ok)
 		return(error);
 
+	deadline_wait();
+
 	// sample at end of SCL cycle
 
 	*bit = sda_is_high() ? 1 : 0;
@@ -314,19 +293,25 @@ iram static i2c_error_t send_start(void)
 
 	// make sure SDA is released and set it to high
 
-	if((error = scl_set_test(false, i2c_delay_send_start_stop_scl_low)) != i2c_error_ok)
-		return(error);
+	scl_low();
+	deadline_start();
+	sda_high();
 
-	if((error = sda_set_test(true, i2c_delay_send_start_stop_scl_low)) != i2c_error_ok)
+	deadline_wait();
+
+	if((error = scl_release()) != i2c_error_ok)
 		return(error);
 
-	if((error = scl_set_test(true, i2c_delay_send_start_stop_scl_high_1)) != i2c_error_ok)
+	if((error = sda_wait_high()) != i2c_error_ok)
 		return(error);
 
+	deadline_wait();
+
 	// send actual start condition
 
-	if((error = sda_set_test(false, i2c_delay_send_start_stop_scl_high_2)) != i2c_error_ok)
-		return(error);
+	sda_low();
+
+	deadline_wait();
 
 	return(i2c_error_ok);
 }
@@ -337,19 +322,22 @@ iram static i2c_error_t send_stop(void)
 
 	// release SDA from last slave's ACK and set it low
 
-	if((error = scl_set_test(false, i2c_delay_send_start_stop_scl_low)) != i2c_error_ok)
-		return(error);
+	scl_low();
+	deadline_start();
+	sda_low();
 
-	if((error = sda_set_test(false, i2c_delay_send_start_stop_scl_low)) != i2c_error_ok)
-		return(error);
+	deadline_wait();
 
-	if((error = scl_set_test(true, i2c_delay_send_start_stop_scl_high_1)) != i2c_error_ok)
+	if((error = scl_release()) != i2c_error_ok)
 		return(error);
 
+	deadline_wait();
+
 	// send actual stop condition
 
-	if((error = sda_set_test(true, i2c_delay_send_start_stop_scl_high_2)) != i2c_error_ok)
-		return(error);
+	sda_high();
+
+	deadline_wait();
 
 	if(sda_is_low())
 	{
@@ -432,7 +420,7 @@ attr_inline i2c_error_t send_header(int address, i2c_direction_t direction)
 	return(i2c_error_ok);
 }
 
-static i2c_error_t i2c_send_sequence(int address, int length, const uint8_t *bytes)
+iram static i2c_error_t i2c_send_sequence(int address, int length, const uint8_t *bytes)
 {
 	int current;
 	i2c_error_t error;
@@ -479,7 +467,7 @@ static i2c_error_t i2c_send_sequence(int address, int length, const uint8_t *byt
 	return(i2c_error_ok);
 }
 
-attr_inline i2c_error_t i2c_receive_sequence(int address, int length, uint8_t *bytes)
+iram static i2c_error_t i2c_receive_sequence(int address, int length, uint8_t *bytes)
 {
 	int current;
 	i2c_error_t error;
@@ -558,6 +546,29 @@ i2c_error_t i2c_receive(int address, int length, uint8_t *bytes)
 	return(i2c_error_ok);
 }
 
+i2c_error_t i2c_probe(int address)
+{
+	i2c_error_t error, stop_error;
+
+	// address only, a NAK just means there is no device, it doesn't need a bus reset
+
+	if(((error = i2c_send_sequence(address, 0, (const uint8_t *)0)) != i2c_error_ok) && (error != i2c_error_address_nak))
+	{
+		i2c_reset();
+		return(error);
+	}
+
+	state = i2c_state_idle;
+
+	if((stop_error = send_stop()) != i2c_error_ok)
+	{
+		i2c_reset();
+		return(stop_error);
+	}
+
+	return(error);
+}
+
 i2c_error_t i2c_send_receive(int address, int sendlength, const uint8_t *sendbytes, int receivelength, uint8_t *receivebytes)
 {
 	i2c_error_t error;
@@ -620,28 +631,169 @@ i2c_error_t i2c_select_bus(unsigned int bus)
 	return(i2c_send1(0x70, bus));
 }
 
+// Run a list of operations back to back, see i2c_script_op_t for the encoding.
+// Data from read operations is concatenated into reply, step is the index of the
+// operation that failed.
+
+i2c_error_t i2c_script(unsigned int length, const uint8_t *script, unsigned int reply_size, uint8_t *reply, unsigned int *reply_length, unsigned int *step)
+{
+	i2c_error_t error;
+	unsigned int offset, op, address, send_length, receive_length, wait_ms, waited_ms, polled_ms;
+	unsigned int reg, mask, value;
+	uint8_t byte;
+
+	*reply_length = 0;
+	waited_ms = 0;
+
+	for(offset = 0, *step = 0; offset < length; (*step)++)
+	{
+		op = script[offset++];
+
+		switch(op)
+		{
+			case(i2c_script_op_end):
+			{
+				return(i2c_error_ok);
+			}
+
+			case(i2c_script_op_write):
+			case(i2c_script_op_read):
+			case(i2c_script_op_write_read):
+			{
+				if((offset + 2) > length)
+					return(i2c_error_out_of_range);
+
+				address = script[offset++];
+				send_length = 0;
+				receive_length = 0;
+
+				if(op == i2c_script_op_read)
+					receive_length = script[offset++];
+				else
+				{
+					send_length = script[offset++];
+
+					if((offset + send_length + ((op == i2c_script_op_write_read) ? 1 : 0)) > length)
+						return(i2c_error_out_of_range);
+
+					if(op == i2c_script_op_write_read)
+						receive_length = script[offset + send_length];
+				}
+
+				if((*reply_length + receive_length) > reply_size)
+					return(i2c_error_overflow);
+
+				if(op == i2c_script_op_write)
+					error = i2c_send(address, send_length, &script[offset]);
+				else if(op == i2c_script_op_read)
+					error = i2c_receive(address, receive_length, &reply[*reply_length]);
+				else
+					error = i2c_send_receive(address, send_length, &script[offset], receive_length, &reply[*reply_length]);
+
+				if(error != i2c_error_ok)
+					return(error);
+
+				offset += send_length + ((op == i2c_script_op_write_read) ? 1 : 0);
+				*reply_length += receive_length;
+
+				break;
+			}
+
+			case(i2c_script_op_delay):
+			{
+				if((offset + 2) > length)
+					return(i2c_error_out_of_range);
+
+				wait_ms = (script[offset + 0] << 8) | script[offset + 1];
+				offset += 2;
+
+				if((waited_ms += wait_ms) > i2c_script_wait_max_ms)
+					return(i2c_error_out_of_range);
+
+				msleep(wait_ms);
+
+				break;
+			}
+
+			case(i2c_script_op_bus):
+			{
+				if((offset + 1) > length)
+					return(i2c_error_out_of_range);
+
+				if((error = i2c_select_bus(script[offset++])) != i2c_error_ok)
+					return(error);
+
+				break;
+			}
+
+			case(i2c_script_op_poll):
+			{
+				if((offset + 6) > length)
+					return(i2c_error_out_of_range);
+
+				address = script[offset + 0];
+				reg = script[offset + 1];
+				mask = script[offset + 2];
+				value = script[offset + 3];
+				wait_ms = (script[offset + 4] << 8) | script[offset + 5];
+				offset += 6;
+
+				for(polled_ms = 0;; polled_ms++)
+				{
+					if((error = i2c_send1_receive(address, reg, 1, &byte)) != i2c_error_ok)
+						return(error);
+
+					if((byte & mask) == value)
+						break;
+
+					if((polled_ms >= wait_ms) || (waited_ms >= i2c_script_wait_max_ms))
+						return(i2c_error_timeout);
+
+					msleep(1);
+					waited_ms++;
+				}
+
+				break;
+			}
+
+			default:
+			{
+				return(i2c_error_out_of_range);
+			}
+		}
+	}
+
+	return(i2c_error_ok);
+}
+
 static i2c_error_t i2c_reset_fixup_bus(void)
 {
 	i2c_error_t error;
 	int current;
 	unsigned int wait_cycles = 0;
 
-	if((error = scl_set_test(true, i2c_delay_fixup_pre_wait)) != i2c_error_ok)
+	deadline_start();
+
+	if((error = scl_release()) != i2c_error_ok)
 		return(error);
 
+	deadline_wait();
+	deadline_wait();
+
 	// if SDA still asserted by slave, cycle SCL until they release it
 
 	if(sda_is_low())
 	{
 		for(current = i2c_config_sda_reset_cycles; current > 0; current--, wait_cycles++)
 		{
-			delay(i2c_delay_fixup_cycle_phase);
+			deadline_wait();
 			scl_low();
-			delay(i2c_delay_fixup_cycle_phase);
+			deadline_start();
+			deadline_wait();
 			sda_high();
-			delay(i2c_delay_fixup_cycle_phase);
+			deadline_wait();
 			scl_high();
-			delay(i2c_delay_fixup_cycle_phase);
+			deadline_wait();
 
 			if(sda_is_high())
 				break;
@@ -656,7 +808,7 @@ static i2c_error_t i2c_reset_fixup_bus(void)
 		log("i2c-reset-fixup-bus: sda stuck resolved after %u cycles\n", wait_cycles);
 	}
 
-	if((error = scl_set_test(true, i2c_delay_fixup_post_wait)) != i2c_error_ok)
+	if((error = scl_release()) != i2c_error_ok)
 	{
 		log("i2c-reset-fixup-bus: bus lock: %u\n", error);
 		return(error);
@@ -697,21 +849,60 @@ i2c_error_t i2c_reset(void)
 
 void i2c_speed_delay(unsigned int speed_delay)
 {
-	i2c_delay_enum_t current;
-	i2c_delay_t *entry;
-	unsigned int config_factor;
+	// speed delay 1000 is 100 kHz, 0 is as fast as possible
+
+	timing.speed_delay = speed_delay;
+	timing.cpu_mhz = system_get_cpu_freq();
+	timing.half_bit = (timing.cpu_mhz * (1000000 / (2 * 100000)) * speed_delay) / 1000;
+	timing.stretch_timeout = timing.cpu_mhz * i2c_config_stretch_timeout_us;
+}
+
+i2c_error_t i2c_speed_measure(int address, unsigned int *bus_hz)
+{
+	i2c_error_t error;
+	unsigned int run;
+	uint32_t start, spent;
+
+	if(!i2c_flags.init_done)
+		return(i2c_error_no_init);
+
+	if(state != i2c_state_idle)
+		return(i2c_error_invalid_state_not_idle);
+
+	// address only transactions, a NAK is fine, only the bus timing matters
 
-	for(current = 0; current < i2c_delay_size; current++)
+	start = ccount();
+
+	for(run = 0; run < i2c_config_measure_runs; run++)
 	{
-		entry = &i2c_delay[current];
+		state = i2c_state_start_send;
+
+		if((error = send_start()) != i2c_error_ok)
+			goto error;
 
-		if(config_flags_match(flag_cpu_high_speed))
-			config_factor = entry->factor_fast;
-		else
-			config_factor = entry->factor_slow;
+		state = i2c_state_header_send;
 
-		entry->delay = speed_delay * config_factor / 1000;
+		if(((error = send_header(address, i2c_direction_send)) != i2c_error_ok) && (error != i2c_error_address_nak))
+			goto error;
+
+		state = i2c_state_idle;
+
+		if((error = send_stop()) != i2c_error_ok)
+			goto error;
 	}
+
+	spent = ccount() - start;
+
+	if(spent == 0)
+		spent = 1;
+
+	*bus_hz = (unsigned int)(((uint64_t)i2c_config_measure_runs * (i2c_config_measure_half_bits / 2) * timing.cpu_mhz * 1000000) / spent);
+
+	return(i2c_error_ok);
+
+error:
+	i2c_reset();
+	return(error);
 }
 
 void i2c_init(unsigned int sda_in, unsigned int scl_in)
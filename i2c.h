@@ -58,12 +58,30 @@ typedef enum
 	i2c_error_in_use,
 	i2c_error_in_use_on_bus_0,
 	i2c_error_overflow,
+	i2c_error_timeout,
 	i2c_error_error,
 	i2c_error_size = i2c_error_error
 } i2c_error_t;
 
 assert_size(i2c_error_t, 4);
 
+typedef enum
+{
+	i2c_script_op_end = 0,
+	i2c_script_op_write,		// <address> <length> <data>...
+	i2c_script_op_read,			// <address> <length>
+	i2c_script_op_write_read,	// <address> <length> <data>... <read length>
+	i2c_script_op_delay,		// <ms msb> <ms lsb>
+	i2c_script_op_bus,			// <bus>
+	i2c_script_op_poll,			// <address> <register> <mask> <value> <timeout ms msb> <timeout ms lsb>
+	i2c_script_op_size,
+} i2c_script_op_t;
+
+enum
+{
+	i2c_script_wait_max_ms = 50,	// delay and poll time in total for one script, this blocks the sdk loop
+};
+
 typedef struct attr_packed
 {
 	unsigned int multiplexer:1;
@@ -86,12 +104,14 @@ do { \
 
 void		i2c_init(unsigned int sda_index, unsigned int scl_index);
 void		i2c_speed_delay(unsigned int speed_delay);
+i2c_error_t	i2c_speed_measure(int address, unsigned int *bus_hz);
 i2c_error_t	i2c_select_bus(unsigned int bus);
 void		i2c_get_info(i2c_info_t *);
 
 i2c_error_t	i2c_send(int address, int length, const uint8_t *bytes);
 i2c_error_t	i2c_receive(int address, int length, uint8_t *bytes);
 i2c_error_t	i2c_send_receive(int address, int sendlength, const uint8_t *sendbytes, int receivelength, uint8_t *receivebytes);
+i2c_error_t	i2c_probe(int address);
 
 i2c_error_t	i2c_send1(int address, int byte0);
 i2c_error_t	i2c_send2(int address, int byte0, int byte1);
@@ -100,6 +120,8 @@ i2c_error_t	i2c_send4(int address, int byte0, int byte1, int byte2, int byte3);
 
 i2c_error_t	i2c_send1_receive(int address, int byte0, int receivelength, uint8_t *receivebytes);
 
+i2c_error_t	i2c_script(unsigned int length, const uint8_t *script, unsigned int reply_size, uint8_t *reply, unsigned int *reply_length, unsigned int *step);
+
 i2c_error_t i2c_reset(void);
 
 #endif
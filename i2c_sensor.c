@@ -4,9 +4,11 @@
 #include "config.h"
 #include "sys_time.h"
 #include "dispatch.h"
+#include "rules.h"
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdlib.h>
 
 enum
 {
@@ -92,6 +94,49 @@ typedef struct
 
 static i2c_sensor_info_t sensor_info;
 
+// The background loop keeps the raw value of every sensor in a cache, so reads
+// from commands, http and rules don't need bus access. A sensor is only read
+// again when its value would otherwise be too old for a reader that uses the
+// default maximum age, not on every round. The calibration is applied when
+// the value is used. A read that asks for a maximum age older than the cached
+// value samples the sensor right away.
+
+typedef struct
+{
+	i2c_sensor_value_t		value;
+	uint64_t				sampled_us;
+	i2c_error_t				error;
+	i2c_sensor_quality_t	quality;
+} i2c_sensor_cache_t;
+
+assert_size(i2c_sensor_cache_t, 48); // 32 + 8 + 4 + 4
+
+static i2c_sensor_cache_t i2c_sensor_cache[i2c_sensor_data_entries];
+
+// A sensor with a sample interval (i2s.interval.<bus>.<sensor>) is only sampled
+// by the background loop when it's due, so the resolution is one background
+// round. Its successful samples are kept in a ring buffer for the aggregates,
+// which is only allocated for sensors that have an interval set.
+
+typedef struct
+{
+	float		value;		// raw, calibration is applied on output
+	uint32_t	time_ms;
+} i2c_sensor_sample_t;
+
+assert_size(i2c_sensor_sample_t, 8);
+
+typedef struct
+{
+	uint64_t			next_sample_us;
+	unsigned int		interval_ms;
+	unsigned int		head;
+	unsigned int		entries;
+	i2c_sensor_sample_t	*sample;
+} i2c_sensor_schedule_t;
+
+static i2c_sensor_schedule_t i2c_sensor_schedule[i2c_sensor_data_entries];
+
 void i2c_sensor_get_info(i2c_sensor_info_t *sensor_info_ptr)
 {
 	*sensor_info_ptr = sensor_info;
@@ -7606,45 +7651,244 @@ roflash static const i2c_sensor_device_table_entry_t device_table[] =
 	},
 };
 
-static i2c_error_t i2c_sensors_detect(void)
+// The sensors found are saved in config with a hash of the bus topology. At
+// the next boot only those are checked, so they come online right away. A full
+// scan then runs in the background, one sensor per invocation, any new sensor
+// found is initialised and added. The saved list is updated when it differs.
+
+typedef struct
+{
+	unsigned int	valid:1;
+	unsigned int	verify:1;
+	unsigned int	entries;
+	unsigned int	current;
+	uint32_t		entry[i2c_sensor_data_entries];	// bus << 16 | id << 8 | address
+} known_sensors_t;
+
+static known_sensors_t known_sensors;
+
+static unsigned int known_sensors_hash(void)
 {
-	const i2c_sensor_device_table_entry_t *device_table_entry;
-	i2c_sensor_data_t *data_entry;
-	i2c_error_t error;
 	i2c_info_t i2c_info;
+	uint8_t topology[4];
 
-	sensor_info.detect_called++;
+	i2c_get_info(&i2c_info);
 
-	if(!sensor_info.detect_started)
+	topology[0] = i2c_info.multiplexer;
+	topology[1] = i2c_info.buses;
+	topology[2] = i2c_sensor_size;
+	topology[3] = i2c_sensor_data_entries;
+
+	return(crc16(sizeof(topology), topology));
+}
+
+static void known_sensors_load(void)
+{
+	unsigned int hash, value, ix;
+	i2c_sensor_flash_basic_t basic;
+
+	known_sensors.valid = 0;
+	known_sensors.verify = 0;
+	known_sensors.entries = 0;
+	known_sensors.current = 0;
+
+	if(!config_get_uint("i2s.detected.hash", &hash, -1, -1) || (hash != known_sensors_hash()))
+		return;
+
+	for(ix = 0; ix < (i2c_sensor_data_entries - 1); ix++)
 	{
-		sensor_info.detect_started_us = time_get_us();
-		sensor_info.detect_started = 1;
+		if(!config_get_uint("i2s.detected.%u", &value, ix, -1))
+			break;
+
+		if(((value >> 8) & 0xff) >= i2c_sensor_size)
+			return;
+
+		flash_to_dram(false, &device_table[(value >> 8) & 0xff].basic, (void *)&basic, sizeof(basic));
+
+		if(basic.address != (value & 0xff))
+			return;
+
+		known_sensors.entry[known_sensors.entries++] = value;
 	}
 
-	if(sensor_info.detect_current_sensor >= i2c_sensor_size)
+	known_sensors.valid = 1;
+	known_sensors.verify = 1;
+	sensor_info.detect_known = known_sensors.entries;
+}
+
+static void known_sensors_save(void)
+{
+	unsigned int ix;
+	uint32_t value;
+	bool changed;
+	const i2c_sensor_data_t *data_entry;
+
+	changed = !known_sensors.valid || (known_sensors.entries != i2c_sensors);
+
+	for(ix = 0; ix < i2c_sensors; ix++)
 	{
-		sensor_info.detect_failed++;
-		goto abort;
+		data_entry = &i2c_sensor_data[ix];
+		value = (data_entry->bus << 16) | (data_entry->basic.id << 8) | (data_entry->basic.address << 0);
+
+		if(!changed && (known_sensors.entry[ix] != value))
+			changed = true;
+
+		known_sensors.entry[ix] = value;
+	}
+
+	known_sensors.entries = i2c_sensors;
+	known_sensors.valid = 1;
+
+	if(!changed)
+		return;
+
+	if(!config_open_write())
+	{
+		log("i2c sensors: cannot save detected sensors (open)\n");
+		return;
+	}
+
+	config_delete("i2s.detected.", true, -1, -1);
+
+	if(!config_set_uint("i2s.detected.hash", known_sensors_hash(), -1, -1))
+		goto error;
+
+	for(ix = 0; ix < known_sensors.entries; ix++)
+		if(!config_set_uint("i2s.detected.%u", known_sensors.entry[ix], ix, -1))
+			goto error;
+
+	if(!config_close_write())
+		log("i2c sensors: cannot save detected sensors (close)\n");
+
+	return;
+
+error:
+	config_abort_write();
+	log("i2c sensors: cannot save detected sensors\n");
+}
+
+// Before the detect functions run on a bus, each address used by the device
+// table is probed once. Only detect functions of addresses that answered are
+// called, which saves most of the (NAK) transactions on a multiplexed bus.
+
+static uint32_t address_present[i2c_busses][128 / 32];
+
+attr_inline bool address_is_present(unsigned int bus, unsigned int address)
+{
+	return(!!(address_present[bus][(address & 0x7f) / 32] & (1UL << (address % 32))));
+}
+
+static void bus_probe(unsigned int bus)
+{
+	const i2c_sensor_device_table_entry_t *device_table_entry;
+	i2c_sensor_flash_basic_t basic;
+	uint32_t probed[128 / 32];
+	unsigned int ix, pass, address;
+
+	for(ix = 0; ix < (128 / 32); ix++)
+		address_present[bus][ix] = 0;
+
+	if(i2c_select_bus(bus) != i2c_error_ok)
+	{
+		sensor_info.detect_bus_select_failed++;
+		goto finish;
 	}
 
+	// devices that sleep (e.g. am2320) wake up on the first access and only answer the second time
+
+	for(pass = 0; pass < 2; pass++)
+	{
+		for(ix = 0; ix < (128 / 32); ix++)
+			probed[ix] = 0;
+
+		if(pass > 0)
+			msleep(2);
+
+		for(ix = 0; ix < i2c_sensor_size; ix++)
+		{
+			device_table_entry = &device_table[ix];
+			flash_to_dram(false, &device_table_entry->basic, (void *)&basic, sizeof(basic));
+			address = basic.address & 0x7f;
+
+			if((basic.primary != i2c_sensor_none) || !device_table_entry->detect_fn)
+				continue;
+
+			if(address_is_present(bus, address) || (probed[address / 32] & (1UL << (address % 32))))
+				continue;
+
+			probed[address / 32] |= 1UL << (address % 32);
+			sensor_info.detect_probed++;
+
+			if(i2c_probe(address) == i2c_error_ok)
+			{
+				address_present[bus][address / 32] |= 1UL << (address % 32);
+				sensor_info.detect_probe_acked++;
+			}
+		}
+	}
+
+finish:
+	i2c_select_bus(0);
+}
+
+static bool schedule_set(unsigned int ix, unsigned int interval_ms)
+{
+	i2c_sensor_schedule_t *schedule;
+
+	schedule = &i2c_sensor_schedule[ix];
+
+	schedule->next_sample_us = 0;
+	schedule->interval_ms = 0;
+	schedule->head = 0;
+	schedule->entries = 0;
+
+	if(!interval_ms)
+	{
+		free(schedule->sample);
+		schedule->sample = (i2c_sensor_sample_t *)0;
+		return(true);
+	}
+
+	if(!schedule->sample && !(schedule->sample = malloc(i2c_sensor_history_size * sizeof(*schedule->sample))))
+	{
+		log("i2c sensor schedule: out of memory\n");
+		return(false);
+	}
+
+	schedule->interval_ms = interval_ms;
+
+	return(true);
+}
+
+// returns false if detection can't continue, probed: skip absent addresses according to bus_probe
+
+static bool sensor_detect(unsigned int bus, i2c_sensor_t sensor, bool probed)
+{
+	const i2c_sensor_device_table_entry_t *device_table_entry;
+	i2c_sensor_data_t *data_entry;
+	unsigned int interval_ms;
+
+	if(i2c_sensor_registered(bus, sensor))
+		return(true);
+
 	if((i2c_sensors + 1) >= i2c_sensor_data_entries)
 	{
 		log("sensors detect: table full\n");
 		sensor_info.detect_failed++;
-		goto abort;
+		return(false);
 	}
 
-	device_table_entry = &device_table[sensor_info.detect_current_sensor];
+	device_table_entry = &device_table[sensor];
 	data_entry = &i2c_sensor_data[i2c_sensors];
 
 	flash_to_dram(false, &device_table_entry->basic, (void *)&data_entry->basic, sizeof(data_entry->basic));
-	data_entry->bus = sensor_info.detect_current_bus;
+	data_entry->bus = bus;
 
-	if(data_entry->basic.id != sensor_info.detect_current_sensor)
+	if(data_entry->basic.id != sensor)
 	{
 		sensor_info.detect_failed++;
-		log("i2c sensor detect: sensor id != index: %u, %u; %u\n", data_entry->basic.id, sensor_info.detect_current_sensor, sizeof(data_entry->basic));
-		goto abort;
+		log("i2c sensor detect: sensor id != index: %u, %u; %u\n", data_entry->basic.id, sensor, sizeof(data_entry->basic));
+		return(false);
 	}
 
 	if(data_entry->basic.primary == i2c_sensor_none) // primary
@@ -7655,7 +7899,7 @@ static i2c_error_t i2c_sensors_detect(void)
 			goto finish;
 		}
 
-		if(i2c_sensor_address_registered(sensor_info.detect_current_bus, data_entry->basic.address))
+		if(i2c_sensor_address_registered(bus, data_entry->basic.address))
 		{
 			sensor_info.detect_skip_duplicate_address++;
 			goto finish;
@@ -7667,27 +7911,86 @@ static i2c_error_t i2c_sensors_detect(void)
 			goto finish;
 		}
 
-		if((error = i2c_select_bus(sensor_info.detect_current_bus)) != i2c_error_ok)
+		if(probed && !address_is_present(bus, data_entry->basic.address))
+		{
+			sensor_info.detect_skip_absent++;
+			goto finish;
+		}
+
+		if(i2c_select_bus(bus) != i2c_error_ok)
 		{
 			sensor_info.detect_bus_select_failed++;
 			goto finish;
 		}
 
-		if((error = device_table_entry->detect_fn(data_entry)) != i2c_error_ok)
+		if(device_table_entry->detect_fn(data_entry) != i2c_error_ok)
 		{
 			sensor_info.detect_failed++;
 			goto finish;
 		}
 	}
 	else // secondary
-		if(!i2c_sensor_registered(sensor_info.detect_current_bus, data_entry->basic.primary))
+		if(!i2c_sensor_registered(bus, data_entry->basic.primary))
 			goto finish;
 
+	i2c_sensor_cache[i2c_sensors].quality = i2c_sensor_quality_none;
+	i2c_sensor_cache[i2c_sensors].error = i2c_error_ok;
+
+	if(!config_get_uint("i2s.interval.%u.%u", &interval_ms, bus, sensor))
+		interval_ms = 0;
+
+	schedule_set(i2c_sensors, interval_ms);
+
 	sensor_info.detect_succeeded++;
 	i2c_sensors++;
 
 finish:
 	i2c_select_bus(0);
+
+	return(true);
+}
+
+static bool i2c_sensors_detect(void)
+{
+	i2c_info_t i2c_info;
+	uint32_t entry;
+
+	sensor_info.detect_called++;
+
+	if(!sensor_info.detect_started)
+	{
+		sensor_info.detect_started_us = time_get_us();
+		sensor_info.detect_started = 1;
+		known_sensors_load();
+	}
+
+	if(known_sensors.verify)
+	{
+		if(known_sensors.current >= known_sensors.entries)
+			goto finished;
+
+		entry = known_sensors.entry[known_sensors.current++];
+
+		if(!sensor_detect((entry >> 16) & 0xff, (i2c_sensor_t)((entry >> 8) & 0xff), false))
+			goto finished;
+
+		sensor_info.detect_known_verified = i2c_sensors;
+
+		return(true);
+	}
+
+	if(sensor_info.detect_current_sensor >= i2c_sensor_size)
+	{
+		sensor_info.detect_failed++;
+		goto finished;
+	}
+
+	if(sensor_info.detect_current_sensor == 0)
+		bus_probe(sensor_info.detect_current_bus);
+
+	if(!sensor_detect(sensor_info.detect_current_bus, sensor_info.detect_current_sensor, true))
+		goto finished;
+
 	i2c_get_info(&i2c_info);
 
 	if(++sensor_info.detect_current_sensor >= i2c_sensor_size)
@@ -7696,12 +7999,15 @@ finish:
 		sensor_info.detect_current_bus++;
 
 		if(sensor_info.detect_current_bus >= i2c_info.buses)
-			goto abort;
+		{
+			known_sensors_save();
+			goto finished;
+		}
 	}
 
 	return(true);
 
-abort:
+finished:
 	i2c_select_bus(0);
 
 	sensor_info.detect_current_sensor = 0;
@@ -7712,6 +8018,61 @@ abort:
 	return(false);
 }
 
+static void i2c_sensors_rescan(void)
+{
+	const i2c_sensor_device_table_entry_t *device_table_entry;
+	i2c_sensor_data_t *data_entry;
+	unsigned int registered;
+	i2c_info_t i2c_info;
+
+	sensor_info.rescan_started = 1;
+	registered = i2c_sensors;
+
+	if(sensor_info.rescan_current_sensor == 0)
+		bus_probe(sensor_info.rescan_current_bus);
+
+	if(!sensor_detect(sensor_info.rescan_current_bus, sensor_info.rescan_current_sensor, true))
+		goto finished;
+
+	if(i2c_sensors > registered)
+	{
+		sensor_info.rescan_found++;
+
+		data_entry = &i2c_sensor_data[registered];
+		device_table_entry = &device_table[data_entry->basic.id];
+
+		if(device_table_entry->init_fn && (i2c_select_bus(data_entry->bus) == i2c_error_ok))
+		{
+			if(device_table_entry->init_fn(data_entry) == i2c_error_ok)
+				sensor_info.init_succeeded++;
+			else
+				sensor_info.init_failed++;
+		}
+
+		i2c_select_bus(0);
+	}
+
+	i2c_get_info(&i2c_info);
+
+	if(++sensor_info.rescan_current_sensor >= i2c_sensor_size)
+	{
+		sensor_info.rescan_current_sensor = 0;
+
+		if(++sensor_info.rescan_current_bus >= i2c_info.buses)
+			goto finished;
+	}
+
+	return;
+
+finished:
+	known_sensors_save();
+
+	known_sensors.verify = 0;
+	sensor_info.rescan_current_sensor = 0;
+	sensor_info.rescan_current_bus = 0;
+	sensor_info.rescan_finished = 1;
+}
+
 static bool i2c_sensors_init(void)
 {
 	const i2c_sensor_device_table_entry_t *device_table_entry;
@@ -7766,6 +8127,134 @@ abort:
 	return(false);
 }
 
+static void sensor_sample(unsigned int ix)
+{
+	const i2c_sensor_device_table_entry_t *device_entry;
+	i2c_sensor_data_t *data_entry;
+	i2c_sensor_cache_t *cache;
+	i2c_sensor_value_t value;
+
+	data_entry = &i2c_sensor_data[ix];
+	device_entry = &device_table[data_entry->basic.id];
+	cache = &i2c_sensor_cache[ix];
+
+	if(!device_entry->read_fn)
+		return;
+
+	sensor_info.sample_called++;
+
+	if((cache->error = i2c_select_bus(data_entry->bus)) == i2c_error_ok)
+	{
+		value.value = 0;
+		value.ch0 = 0;
+		value.ch1 = 0;
+		value.ch2 = 0;
+		value.ch3 = 0;
+		value.scaling = 0;
+
+		cache->error = device_entry->read_fn(data_entry, &value);
+	}
+
+	i2c_select_bus(0);
+
+	if(cache->error == i2c_error_ok)
+	{
+		cache->value = value;
+		cache->sampled_us = time_get_us();
+		cache->quality = i2c_sensor_quality_ok;
+	}
+	else
+	{
+		sensor_info.sample_failed++;
+
+		if(cache->quality == i2c_sensor_quality_ok)
+			cache->quality = i2c_sensor_quality_stale;
+	}
+}
+
+static void sensor_sample_scheduled(unsigned int ix)
+{
+	i2c_sensor_schedule_t *schedule;
+	const i2c_sensor_cache_t *cache;
+	i2c_sensor_sample_t *sample;
+	uint64_t now;
+
+	schedule = &i2c_sensor_schedule[ix];
+	cache = &i2c_sensor_cache[ix];
+	now = time_get_us();
+
+	if(!schedule->interval_ms)
+	{
+		// refresh one round before the value gets older than the default maximum age
+
+		if((cache->quality != i2c_sensor_quality_ok) ||
+				((now - cache->sampled_us) >= ((i2c_sensor_max_age_default_ms - i2c_sensor_background_round_ms) * 1000ULL)))
+			sensor_sample(ix);
+		else
+			sensor_info.sample_not_due++;
+
+		return;
+	}
+
+	if(now < schedule->next_sample_us)
+	{
+		sensor_info.sample_not_due++;
+		return;
+	}
+
+	// keep the phase, unless we're a full interval or more behind
+
+	schedule->next_sample_us += schedule->interval_ms * 1000ULL;
+
+	if(schedule->next_sample_us <= now)
+		schedule->next_sample_us = now + (schedule->interval_ms * 1000ULL);
+
+	sensor_sample(ix);
+
+	if(cache->error != i2c_error_ok)
+		return;
+
+	sample = &schedule->sample[schedule->head];
+	sample->value = cache->value.value;
+	sample->time_ms = (uint32_t)(cache->sampled_us / 1000);
+
+	schedule->head = (schedule->head + 1) % i2c_sensor_history_size;
+
+	if(schedule->entries < i2c_sensor_history_size)
+		schedule->entries++;
+
+	sensor_info.sample_history++;
+}
+
+// returns the cache entry, sampled now if it has no value or it's older than max_age_ms,
+// with i2c_sensor_max_age_auto it follows the sample interval for sensors that have one,
+// so readers like rules and http don't read the bus outside the schedule
+
+static bool sensor_cached(int bus, i2c_sensor_t sensor, unsigned int max_age_ms, i2c_sensor_data_t **data_entry, const i2c_sensor_cache_t **cache)
+{
+	i2c_sensor_cache_t *cache_entry;
+	unsigned int ix, interval_ms;
+
+	if(!sensor_data_get_entry(bus, sensor, data_entry))
+		return(false);
+
+	ix = *data_entry - i2c_sensor_data;
+	cache_entry = &i2c_sensor_cache[ix];
+	interval_ms = i2c_sensor_schedule[ix].interval_ms;
+
+	if(max_age_ms == (unsigned int)i2c_sensor_max_age_auto)
+		max_age_ms = umax(i2c_sensor_max_age_default_ms, interval_ms ? interval_ms + i2c_sensor_background_round_ms : 0);
+
+	if((cache_entry->quality != i2c_sensor_quality_ok) || ((time_get_us() - cache_entry->sampled_us) > (max_age_ms * 1000ULL)))
+		sensor_sample(ix);
+	else
+		sensor_info.sample_cached++;
+
+	*cache = cache_entry;
+
+	return(true);
+}
+
 static bool i2c_sensors_background(void)
 {
 	const i2c_sensor_device_table_entry_t *device_table_entry;
@@ -7809,11 +8298,14 @@ static bool i2c_sensors_background(void)
 finish:
 	i2c_select_bus(0);
 
+	sensor_sample_scheduled(sensor_info.background_current_sensor);
+
 	if(++sensor_info.background_current_sensor >= i2c_sensors)
 	{
 		sensor_info.background_current_sensor = 0;
 		sensor_info.background_wrapped++;
-		next_background_run = time_get_us() + 1000000ULL;
+		next_background_run = time_get_us() + (i2c_sensor_background_round_ms * 1000ULL);
+		rules_sensors_updated();
 	}
 
 	return(false);
@@ -7834,7 +8326,12 @@ void i2c_sensors_periodic(void)
 	bool repost;
 
 	if(sensor_info.init_finished)
+	{
+		if(known_sensors.verify && !sensor_info.rescan_finished)
+			i2c_sensors_rescan();
+
 		repost = i2c_sensors_background();
+	}
 	else
 		if(sensor_info.detect_finished)
 			repost = i2c_sensors_init();
@@ -7845,14 +8342,39 @@ void i2c_sensors_periodic(void)
 		dispatch_post_task(task_prio_low, task_periodic_i2c_sensors, 0, 0, 0);
 }
 
-bool i2c_sensor_read(string_t *dst, int bus, i2c_sensor_t sensor, bool verbose, bool html)
+bool i2c_sensor_get_value(int bus, i2c_sensor_t sensor, double *value)
+{
+	int int_factor, int_offset;
+	i2c_sensor_data_t *data_entry;
+	const i2c_sensor_cache_t *cache;
+
+	if((sensor < 0) || (sensor >= i2c_sensor_size))
+		return(false);
+
+	if(!sensor_cached(bus, sensor, i2c_sensor_max_age_auto, &data_entry, &cache))
+		return(false);
+
+	if(cache->quality != i2c_sensor_quality_ok)
+		return(false);
+
+	if(!config_get_int("i2s.%u.%u.factor", &int_factor, bus, sensor))
+		int_factor = 1000;
+
+	if(!config_get_int("i2s.%u.%u.offset", &int_offset, bus, sensor))
+		int_offset = 0;
+
+	*value = (cache->value.value * int_factor / 1000.0) + (int_offset / 1000.0);
+
+	return(true);
+}
+
+bool i2c_sensor_read(string_t *dst, int bus, i2c_sensor_t sensor, unsigned int max_age_ms, bool verbose, bool html)
 {
-	i2c_error_t error;
-	i2c_sensor_value_t value;
 	int int_factor, int_offset;
 	unsigned int start_offset;
 	double extracooked;
 	i2c_sensor_data_t *data_entry;
+	const i2c_sensor_cache_t *cache;
 	const i2c_sensor_device_table_entry_t *device_entry;
 	char device_name[i2c_sensor_device_table_name_size];
 	char device_type[i2c_sensor_device_table_type_size];
@@ -7890,43 +8412,35 @@ bool i2c_sensor_read(string_t *dst, int bus, i2c_sensor_t sensor, bool verbose,
 		return(false);
 	}
 
-	if((error = i2c_select_bus(bus)) != i2c_error_ok)
+	if(!sensor_cached(bus, sensor, max_age_ms, &data_entry, &cache))
 	{
-		string_format(dst, "i2c sensor read: select bus #%d error", bus);
-		i2c_error_format_string(dst, error);
-		i2c_select_bus(0);
+		string_format(dst, "i2c sensor read: sensor #%u unknown (4)", sensor);
 		return(false);
 	}
 
-	error = i2c_error_ok;
-
 	if(html)
 		string_format(dst, "%d</td><td align=\"right\">%u</td><td align=\"right\">0x%02lx</td><td>%s</td><td>%s</td>", bus, sensor, data_entry->basic.address, device_name, device_type);
 	else
 		string_format(dst, "sensor %d/%02u@%02lx: %s, %s: ", bus, sensor, data_entry->basic.address, device_name, device_type);
 
-	value.value = 0;
-	value.ch0 = 0;
-	value.ch1 = 0;
-	value.ch2 = 0;
-	value.ch3 = 0;
-	value.scaling = 0;
+	if(!config_get_int("i2s.%u.%u.factor", &int_factor, bus, sensor))
+		int_factor = 1000;
 
-	if((error = device_entry->read_fn(data_entry, &value)) == i2c_error_ok)
-	{
-		if(!config_get_int("i2s.%u.%u.factor", &int_factor, bus, sensor))
-			int_factor = 1000;
-
-		if(!config_get_int("i2s.%u.%u.offset", &int_offset, bus, sensor))
-			int_offset = 0;
+	if(!config_get_int("i2s.%u.%u.offset", &int_offset, bus, sensor))
+		int_offset = 0;
 
-		extracooked = (value.value * int_factor / 1000.0) + (int_offset / 1000.0);
+	if(cache->quality != i2c_sensor_quality_none)
+	{
+		extracooked = (cache->value.value * int_factor / 1000.0) + (int_offset / 1000.0);
 
 		if(html)
 			string_format(dst, "<td align=\"right\">%.*f %s", data_entry->basic.precision, extracooked, device_unity);
 		else
 			string_format(dst, "[%.*f] %s", data_entry->basic.precision, extracooked, device_unity);
 
+		if(cache->quality == i2c_sensor_quality_stale)
+			string_append(dst, " (stale)");
+
 		if(verbose)
 		{
 			while(string_space(dst) && ((string_length(dst) - start_offset) < 56))
@@ -7934,37 +8448,25 @@ bool i2c_sensor_read(string_t *dst, int bus, i2c_sensor_t sensor, bool verbose,
 
 			if(string_space(dst))
 				string_format(dst, " debug: ch0: %7d, ch1: %6d, ch2: %4d, ch3: %4d, scaling: %1u",
-						value.ch0, value.ch1, value.ch2, value.ch3, value.scaling);
+						cache->value.ch0, cache->value.ch1, cache->value.ch2, cache->value.ch3, cache->value.scaling);
 		}
 	}
 	else
-	{
-		if(verbose)
-		{
-			string_append(dst, "error");
-			i2c_error_format_string(dst, error);
-		}
-		else
-			string_append(dst, "error");
-	}
+		string_append(dst, "error");
 
 	if(verbose)
 	{
-		if(!config_get_int("i2s.%u.%u.factor", &int_factor, bus, sensor))
-			int_factor = 1000;
-
-		if(!config_get_int("i2s.%u.%u.offset", &int_offset, bus, sensor))
-			int_offset = 0;
+		if(cache->error != i2c_error_ok)
+			i2c_error_format_string(dst, cache->error);
 
-		string_format(dst, ", raw: %7.2f, calibration: f = %.2f, o = %.2f", value.value, int_factor / 1000.0, int_offset / 1000.0);
+		string_format(dst, ", raw: %7.2f, calibration: f = %.2f, o = %.2f, age: %u ms", cache->value.value, int_factor / 1000.0, int_offset / 1000.0,
+				(cache->quality != i2c_sensor_quality_none) ? (unsigned int)((time_get_us() - cache->sampled_us) / 1000) : 0);
 	}
 
-	i2c_select_bus(0);
-
 	return(true);
 }
 
-void i2c_sensor_dump(bool verbose, string_t *dst)
+void i2c_sensor_dump(bool verbose, unsigned int max_age_ms, string_t *dst)
 {
 	unsigned int ix;
 	i2c_sensor_data_t *data_entry;
@@ -7972,7 +8474,117 @@ void i2c_sensor_dump(bool verbose, string_t *dst)
 	for(ix = 0; ix < i2c_sensors; ix++)
 	{
 		data_entry = &i2c_sensor_data[ix];
-		i2c_sensor_read(dst, data_entry->bus, data_entry->basic.id, verbose, false);
+		i2c_sensor_read(dst, data_entry->bus, data_entry->basic.id, max_age_ms, verbose, false);
 		string_append(dst, "\n");
 	}
 }
+
+bool i2c_sensor_set_interval(int bus, i2c_sensor_t sensor, unsigned int interval_ms)
+{
+	i2c_sensor_data_t *data_entry;
+
+	if((sensor < 0) || (sensor >= i2c_sensor_size))
+		return(false);
+
+	if(!sensor_data_get_entry(bus, sensor, &data_entry))
+		return(false);
+
+	return(schedule_set(data_entry - i2c_sensor_data, interval_ms));
+}
+
+bool i2c_sensor_history(string_t *dst, int bus, i2c_sensor_t sensor, unsigned int window_s, bool list)
+{
+	int int_factor, int_offset;
+	unsigned int ix, slot, count;
+	uint32_t now_ms, age_ms;
+	double value, min, max, sum, sum_squares, mean, variance;
+	i2c_sensor_data_t *data_entry;
+	const i2c_sensor_schedule_t *schedule;
+	const i2c_sensor_device_table_entry_t *device_entry;
+	char device_name[i2c_sensor_device_table_name_size];
+	char device_type[i2c_sensor_device_table_type_size];
+	char device_unity[i2c_sensor_device_table_unity_size];
+
+	if((sensor < 0) || (sensor >= i2c_sensor_size) || !sensor_data_get_entry(bus, sensor, &data_entry))
+	{
+		string_format(dst, "> i2c sensor %d/%u not detected\n", bus, sensor);
+		return(false);
+	}
+
+	schedule = &i2c_sensor_schedule[data_entry - i2c_sensor_data];
+
+	if(!schedule->interval_ms)
+	{
+		string_format(dst, "> i2c sensor %d/%u has no sample interval set, no history\n", bus, sensor);
+		return(false);
+	}
+
+	device_entry = &device_table[data_entry->basic.id];
+
+	flash_to_dram(true, &device_entry->name, device_name, sizeof(device_name));
+	flash_to_dram(true, &device_entry->type, device_type, sizeof(device_type));
+	flash_to_dram(true, &device_entry->unity, device_unity, sizeof(device_unity));
+
+	if(!config_get_int("i2s.%u.%u.factor", &int_factor, bus, sensor))
+		int_factor = 1000;
+
+	if(!config_get_int("i2s.%u.%u.offset", &int_offset, bus, sensor))
+		int_offset = 0;
+
+	now_ms = (uint32_t)(time_get_us() / 1000);
+	min = max = sum = sum_squares = 0;
+
+	// newest first, stop at the first sample outside the window
+
+	for(ix = 0, count = 0; ix < schedule->entries; ix++)
+	{
+		slot = (schedule->head + i2c_sensor_history_size - 1 - ix) % i2c_sensor_history_size;
+		age_ms = now_ms - schedule->sample[slot].time_ms;
+
+		if(window_s && (age_ms > (window_s * 1000)))
+			break;
+
+		value = (schedule->sample[slot].value * int_factor / 1000.0) + (int_offset / 1000.0);
+
+		if(list)
+			string_format(dst, "> %2u: %.*f %s, %u s ago\n", ix, data_entry->basic.precision, value, device_unity, (unsigned int)(age_ms / 1000));
+
+		if(!count || (value < min))
+			min = value;
+
+		if(!count || (value > max))
+			max = value;
+
+		sum += value;
+		sum_squares += value * value;
+		count++;
+	}
+
+	string_format(dst, "> sensor %d/%02u: %s, %s, interval: %u ms, window: ", bus, sensor, device_name, device_type, schedule->interval_ms);
+
+	if(window_s)
+		string_format(dst, "%u s", window_s);
+	else
+		string_append(dst, "all");
+
+	string_format(dst, ", samples: %u/%u\n", count, schedule->entries);
+
+	if(!count)
+		return(true);
+
+	mean = sum / count;
+
+	// rounding can make it slightly negative for a constant value
+
+	if((variance = (sum_squares / count) - (mean * mean)) < 0)
+		variance = 0;
+
+	string_format(dst, "> min: %.*f, max: %.*f, mean: %.*f, stddev: %.*f %s\n",
+			data_entry->basic.precision, min,
+			data_entry->basic.precision, max,
+			data_entry->basic.precision + 1, mean,
+			data_entry->basic.precision + 1, sqrt(variance),
+			device_unity);
+
+	return(true);
+}
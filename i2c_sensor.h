@@ -85,6 +85,22 @@ typedef enum
 
 assert_size(i2c_sensor_t, 4);
 
+typedef enum
+{
+	i2c_sensor_quality_none = 0,	// no successful read yet
+	i2c_sensor_quality_ok,
+	i2c_sensor_quality_stale,		// last read failed, value is from an earlier read
+} i2c_sensor_quality_t;
+
+enum
+{
+	i2c_sensor_max_age_default_ms = 5000,
+	i2c_sensor_max_age_auto = -1,	// default maximum age, or the sample interval for sensors that have one
+	i2c_sensor_background_round_ms = 1000,
+	i2c_sensor_history_size = 32,
+	i2c_sensor_interval_max_ms = 3600000,
+};
+
 typedef struct
 {
 	unsigned int	periodic_called;
@@ -103,6 +119,16 @@ typedef struct
 	unsigned int	detect_skip_duplicate_address;
 	unsigned int	detect_current_bus;
 	i2c_sensor_t	detect_current_sensor;
+	unsigned int	detect_known;
+	unsigned int	detect_known_verified;
+	unsigned int	detect_probed;
+	unsigned int	detect_probe_acked;
+	unsigned int	detect_skip_absent;
+	unsigned int	rescan_started:1;
+	unsigned int	rescan_finished:1;
+	unsigned int	rescan_found;
+	unsigned int	rescan_current_bus;
+	i2c_sensor_t	rescan_current_sensor;
 
 	uint64_t		init_started_us;
 	uint64_t		init_finished_us;
@@ -123,14 +149,23 @@ typedef struct
 	unsigned int	background_wrapped;
 	unsigned int	background_current_sensor;
 	unsigned int	background_finished;
+
+	unsigned int	sample_called;
+	unsigned int	sample_failed;
+	unsigned int	sample_cached;
+	unsigned int	sample_not_due;
+	unsigned int	sample_history;
 } i2c_sensor_info_t;
 
-assert_size(i2c_sensor_info_t, 152);
+assert_size(i2c_sensor_info_t, 200);
 
 void i2c_sensor_get_info(i2c_sensor_info_t *);
 void i2c_sensors_periodic(void);
-bool i2c_sensor_read(string_t *, int bus, i2c_sensor_t, bool verbose, bool html);
+bool i2c_sensor_read(string_t *, int bus, i2c_sensor_t, unsigned int max_age_ms, bool verbose, bool html);
+bool i2c_sensor_get_value(int bus, i2c_sensor_t, double *value);
 bool i2c_sensor_registered(int bus, i2c_sensor_t);
-void i2c_sensor_dump(bool verbose, string_t *dst);
+void i2c_sensor_dump(bool verbose, unsigned int max_age_ms, string_t *dst);
+bool i2c_sensor_set_interval(int bus, i2c_sensor_t, unsigned int interval_ms);
+bool i2c_sensor_history(string_t *, int bus, i2c_sensor_t, unsigned int window_s, bool list);
 
 #endif
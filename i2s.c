@@ -8,6 +8,9 @@
 #include <stdint.h>
 
 static bool inited = false;
+static bool dma = false;
+static volatile bool dma_busy = false;
+static i2s_dma_done_fn_t dma_done_fn = (i2s_dma_done_fn_t)0;
 
 enum
 {
@@ -50,6 +53,30 @@ done:
 	ets_isr_unmask(1 << ETS_SPI_INUM);
 }
 
+iram static void slc_callback(void *arg)
+{
+	uint32_t status;
+
+	ets_isr_mask(1 << ETS_SLC_INUM);
+
+	status = read_peri_reg(SLC_INT_STATUS);
+	write_peri_reg(SLC_INT_CLR, 0xffffffff);
+
+	if(!(status & SLC_RX_EOF_INT))
+		goto done;
+
+	dma_busy = false;
+
+	// the last words of the chain are still in the fifo, stop the transmitter
+	// when it has drained, unless the owner has started another chain already
+
+	if(!dma_done_fn || !dma_done_fn())
+		i2s_interrupt_arm(true);
+
+done:
+	ets_isr_unmask(1 << ETS_SLC_INUM);
+}
+
 /*
  * Espressif black magic. No clue how it works, so please don't ask.
  */
@@ -196,9 +223,115 @@ bool i2s_send(unsigned int length, const uint8_t *data)
 	return(true);
 }
 
+// one fifo entry per word, no repacking
+
+bool i2s_send_words(unsigned int words, const uint32_t *data)
+{
+	if(!inited)
+	{
+		log("! i2s: not inited\n");
+		return(false);
+	}
+
+	for(; words > 0; words--)
+	{
+		write_peri_reg(I2STXFIFO, *data++);
+		fifo_count++;
+	}
+
+	return(true);
+}
+
 void i2s_flush(void)
 {
 	i2s_interrupt_arm(true);
 	set_peri_reg_mask(I2SCONF, I2S_I2S_TX_START);
 	fifo_count = 0;
 }
+
+// the slc ("sdio link controller") feeds the i2s transmit fifo from a chain of descriptors in memory
+
+bool i2s_dma_init(i2s_dma_done_fn_t done_fn)
+{
+	if(!inited)
+	{
+		log("! i2s: not inited\n");
+		return(false);
+	}
+
+	set_peri_reg_mask(SLC_CONF0, SLC_RXLINK_RST | SLC_TXLINK_RST);
+	clear_peri_reg_mask(SLC_CONF0, SLC_RXLINK_RST | SLC_TXLINK_RST);
+
+	set_peri_reg_mask(SLC_INT_CLR, 0xffffffff);
+	clear_peri_reg_mask(SLC_INT_CLR, 0xffffffff);
+
+	clear_peri_reg_mask(SLC_CONF0, SLC_MODE << SLC_MODE_S);
+	set_peri_reg_mask(SLC_CONF0, 1 << SLC_MODE_S);
+
+	set_peri_reg_mask(SLC_RX_DSCR_CONF, SLC_INFOR_NO_REPLACE | SLC_TOKEN_NO_REPLACE);
+	clear_peri_reg_mask(SLC_RX_DSCR_CONF, SLC_RX_FILL_EN | SLC_RX_EOF_MODE | SLC_RX_FILL_MODE);
+
+	set_peri_reg_mask(I2S_FIFO_CONF, I2S_I2S_DSCR_EN);
+
+	dma_done_fn = done_fn;
+	dma_busy = false;
+
+	ets_isr_attach(ETS_SLC_INUM, slc_callback, (void *)0);
+	write_peri_reg(SLC_INT_ENA, SLC_RX_EOF_INT);
+	ets_isr_unmask(1 << ETS_SLC_INUM);
+
+	dma = true;
+
+	return(true);
+}
+
+unsigned int i2s_dma_descriptors(unsigned int words)
+{
+	return((words + i2s_dma_descriptor_words - 1) / i2s_dma_descriptor_words);
+}
+
+void i2s_dma_setup(slc_pointer_t *descriptor, const uint32_t *buffer, unsigned int words)
+{
+	unsigned int chunk;
+
+	while(words > 0)
+	{
+		chunk = words > i2s_dma_descriptor_words ? i2s_dma_descriptor_words : words;
+		words -= chunk;
+
+		descriptor->blocksize = chunk * 4;
+		descriptor->datalen = chunk * 4;
+		descriptor->unused = 0;
+		descriptor->eof = words == 0;
+		descriptor->owner = 1;
+		descriptor->buffer = (void *)buffer;
+		descriptor->next_link = (words > 0) ? (void *)(descriptor + 1) : (void *)0;
+
+		buffer += chunk;
+		descriptor++;
+	}
+}
+
+// may be called from the done callback (isr), otherwise call with the slc interrupt masked
+
+iram bool i2s_dma_start(const slc_pointer_t *descriptor)
+{
+	if(!dma || dma_busy)
+		return(false);
+
+	i2s_interrupt_arm(false);
+
+	dma_busy = true;
+
+	clear_peri_reg_mask(SLC_RX_LINK, SLC_RXLINK_DESCADDR_MASK);
+	set_peri_reg_mask(SLC_RX_LINK, ((uint32_t)descriptor) & SLC_RXLINK_DESCADDR_MASK);
+	set_peri_reg_mask(SLC_RX_LINK, SLC_RXLINK_START);
+	set_peri_reg_mask(I2SCONF, I2S_I2S_TX_START);
+
+	return(true);
+}
+
+bool i2s_dma_busy(void)
+{
+	return(dma_busy);
+}
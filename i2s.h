@@ -1,11 +1,27 @@
 #ifndef __i2s_h__
 #define __i2s_h__
 
+#include "eagle.h"
+
 #include <stdint.h>
 #include <stdbool.h>
 
+enum
+{
+	i2s_dma_descriptor_words = 1023, // slc descriptor length is 12 bits
+};
+
+typedef bool (*i2s_dma_done_fn_t)(void); // called from isr, return true if another chain has been started
+
 bool i2s_init(void);
 bool i2s_send(unsigned int length, const uint8_t *data);
+bool i2s_send_words(unsigned int words, const uint32_t *data);
 void i2s_flush(void);
 
+bool			i2s_dma_init(i2s_dma_done_fn_t done_fn);
+unsigned int	i2s_dma_descriptors(unsigned int words);
+void			i2s_dma_setup(slc_pointer_t *descriptor, const uint32_t *buffer, unsigned int words);
+bool			i2s_dma_start(const slc_pointer_t *descriptor);
+bool			i2s_dma_busy(void);
+
 #endif
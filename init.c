@@ -108,5 +108,5 @@ static void user_init2(void)
 	log("[system] boot done\n");
 
 	if(config_flags_match(flag_auto_sequencer))
-		sequencer_start(0, 1);
+		sequencer_start(0, 0, 1);
 }
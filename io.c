@@ -12,9 +12,14 @@
 #include "sequencer.h"
 #include "dispatch.h"
 #include "remote_trigger.h"
+#include "io_event.h"
+#include "rules.h"
+#include "ledpixel_effect.h"
+#include "gamma.h"
 #include "spi.h"
 #include "io_mcp.h"
 
+#include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -63,6 +68,64 @@ static const io_info_entry_t *const io_info[io_id_size] =
 
 static io_data_t io_data;
 
+// pins that need servicing from io_periodic_fast (running timers and ramping pwm outputs),
+// so the fast tick doesn't need to walk all pins of all ios
+
+typedef struct
+{
+	unsigned int	count;
+	uint16_t		mask[io_id_size];
+	config_io_t		entry[io_id_size * max_pins_per_io];
+} io_active_pins_t;
+
+static io_active_pins_t io_active_pins;
+
+// rotary encoders are decoded with a transition table, directly from the gpio isr
+// or from the mcp/pcf pin change handler, the accumulated steps are processed from a task
+
+enum
+{
+	io_renc_idle_us = 250000,
+	io_renc_triggers_max = 16,
+};
+
+typedef struct
+{
+	uint8_t		io;
+	uint8_t		pin_a;			// lowest numbered pin of the pair
+	uint8_t		pin_b;
+	uint8_t		pin_config;		// the "a" pin, holds trigger, acceleration and invert flag
+	uint8_t		state;
+	uint8_t		state_valid;
+	uint8_t		fill[2];
+	int32_t		steps;
+	uint32_t	last_us;
+	uint32_t	velocity;		// steps per second
+} io_renc_state_t;
+
+assert_size(io_renc_state_t, 20);
+
+typedef struct
+{
+	unsigned int	count;
+	bool			pending;
+	uint16_t		pins[io_id_size];
+	io_renc_state_t	*encoder;		// one per configured pin pair, allocated at setup
+} io_renc_t;
+
+static io_renc_t io_renc;
+
+// index is (previous a << 3) | (previous b << 2) | (current a << 1) | (current b << 0),
+// transitions where both pins changed are invalid
+
+static const int8_t io_renc_transition[16] =
+{
+	 0, -1,  1,  0,
+	 1,  0,  0, -1,
+	-1,  0,  0,  1,
+	 0,  1, -1,  0,
+};
+
 typedef struct
 {
 	attr_flash_align	uint32_t	mode;
@@ -91,6 +154,7 @@ roflash static const io_mode_trait_t io_mode_traits[io_pin_size] =
 	{ io_pin_rotary_encoder,	"renc",			"rotary encoder input"	},
 	{ io_pin_spi,				"spi",			"spi"					},
 	{ io_pin_pcint,				"pcint",		"pin change interrupt"	},
+	{ io_pin_frequency,			"freq",			"frequency measurement"	},
 };
 
 static io_pin_mode_t io_mode_from_string(const string_t *src)
@@ -342,7 +406,7 @@ roflash static const io_trigger_action_t io_trigger_action[io_trigger_size] =
 	{ io_trigger_start,		"start"		},
 };
 
-static io_trigger_t string_to_trigger_action(const string_t *src)
+io_trigger_t string_to_trigger_action(const string_t *src)
 {
 	unsigned int ix;
 	const io_trigger_action_t *entry;
@@ -482,6 +546,7 @@ static io_error_t io_read_pin_x(string_t *errormsg, const io_info_entry_t *info,
 		case(io_pin_trigger):
 		case(io_pin_rotary_encoder):
 		case(io_pin_pcint):
+		case(io_pin_frequency):
 		{
 			*value = pin_data->value;
 			break;
@@ -525,6 +590,14 @@ static io_error_t io_write_pin_x(string_t *errormsg, const io_info_entry_t *info
 			break;
 		}
 
+		case(io_pin_frequency):
+		{
+			if(errormsg)
+				string_append(errormsg, "cannot write to this pin");
+
+			return(io_error);
+		}
+
 		case(io_pin_ledpixel):
 		{
 			if(io_ledpixel_pinmask(value) != io_ok)
@@ -571,7 +644,66 @@ static io_error_t io_set_mask_x(string_t *errormsg, const io_info_entry_t *info,
 	return(info->set_mask_fn(errormsg, info, mask, pins));
 }
 
-static io_error_t io_trigger_pin_x(string_t *errormsg, const io_info_entry_t *info, io_data_pin_entry_t *pin_data, io_config_pin_entry_t *pin_config, int pin, io_trigger_t trigger_type)
+static bool io_pin_needs_service(const io_config_pin_entry_t *pin_config, const io_data_pin_entry_t *pin_data)
+{
+	switch(pin_config->mode)
+	{
+		case(io_pin_timer):
+		{
+			return(pin_data->direction != io_dir_none);
+		}
+
+		case(io_pin_output_pwm1):
+		case(io_pin_output_pwm2):
+		{
+			return((pin_config->shared.output_pwm.upper_bound > pin_config->shared.output_pwm.lower_bound) &&
+					(pin_config->speed > 0) &&
+					(pin_data->direction != io_dir_none));
+		}
+
+		case(io_pin_frequency):
+		{
+			return(true);
+		}
+
+		default:
+		{
+			return(false);
+		}
+	}
+}
+
+static void io_active_pin_update(unsigned int io, unsigned int pin)
+{
+	unsigned int index;
+	bool active, listed;
+
+	active = io_data[io].detected && io_pin_needs_service(&io_config[io][pin], &io_data[io].pin[pin]);
+	listed = !!(io_active_pins.mask[io] & (1 << pin));
+
+	if(active == listed)
+		return;
+
+	if(active)
+	{
+		io_active_pins.entry[io_active_pins.count].io = io;
+		io_active_pins.entry[io_active_pins.count].pin = pin;
+		io_active_pins.count++;
+		io_active_pins.mask[io] |= 1 << pin;
+		return;
+	}
+
+	for(index = 0; index < io_active_pins.count; index++)
+		if((io_active_pins.entry[index].io == io) && (io_active_pins.entry[index].pin == pin))
+			break;
+
+	if(index < io_active_pins.count)
+		io_active_pins.entry[index] = io_active_pins.entry[--io_active_pins.count];
+
+	io_active_pins.mask[io] &= ~(1 << pin);
+}
+
+static io_error_t io_trigger_pin_action(string_t *errormsg, const io_info_entry_t *info, io_data_pin_entry_t *pin_data, io_config_pin_entry_t *pin_config, int pin, io_trigger_t trigger_type)
 {
 	io_error_t error;
 	unsigned int old_value, trigger;
@@ -1011,6 +1143,116 @@ io_error_t io_set_mask(string_t *error, int io, unsigned int mask, unsigned int
 	return(io_set_mask_x(error, info, mask, pins));
 }
 
+// collect digital output changes per io, then update each io with one set_mask call (one bus transaction on expanders)
+
+void io_write_batch_init(io_write_batch_t *batch)
+{
+	unsigned int io;
+
+	for(io = 0; io < io_id_size; io++)
+	{
+		batch->mask[io] = 0;
+		batch->value[io] = 0;
+	}
+}
+
+io_error_t io_write_batch_add(string_t *error, io_write_batch_t *batch, unsigned int io, unsigned int pin, unsigned int value)
+{
+	const io_config_pin_entry_t *pin_config;
+
+	if(io >= io_id_size)
+	{
+		if(error)
+			string_append(error, "io out of range\n");
+		return(io_error);
+	}
+
+	if(!io_data[io].detected)
+	{
+		if(error)
+			string_append(error, "io not available\n");
+		return(io_error);
+	}
+
+	if(pin >= io_info[io]->pins)
+	{
+		if(error)
+			string_append(error, "pin out of range\n");
+		return(io_error);
+	}
+
+	pin_config = &io_config[io][pin];
+
+	if((pin_config->mode != io_pin_output_digital) || (pin_config->dynamic_flags & io_flag_dynamic_suspended))
+	{
+		if(error)
+			string_format(error, "pin %u/%u is not an active digital output\n", io, pin);
+		return(io_error);
+	}
+
+	batch->mask[io] |= 1 << pin;
+
+	if(value)
+		batch->value[io] |= 1 << pin;
+	else
+		batch->value[io] &= ~(1 << pin);
+
+	return(io_ok);
+}
+
+io_error_t io_write_batch_flush(string_t *error, io_write_batch_t *batch)
+{
+	const io_info_entry_t *info;
+	const io_config_pin_entry_t *pin_config;
+	unsigned int io, pin, pins;
+
+	for(io = 0; io < io_id_size; io++)
+	{
+		if(!batch->mask[io])
+			continue;
+
+		info = io_info[io];
+
+		if(!info->set_mask_fn)
+		{
+			for(pin = 0; pin < info->pins; pin++)
+				if((batch->mask[io] & (1 << pin)) &&
+						(io_write_pin_x(error, info, &io_data[io].pin[pin], &io_config[io][pin], pin, !!(batch->value[io] & (1 << pin))) != io_ok))
+					return(io_error);
+
+			continue;
+		}
+
+		// set_mask writes raw pin states, so apply inversion here, like write_pin does
+
+		for(pin = 0, pins = batch->value[io]; pin < info->pins; pin++)
+		{
+			pin_config = &io_config[io][pin];
+
+			if((batch->mask[io] & (1 << pin)) && (pin_config->static_flags & io_flag_static_invert))
+				pins ^= 1 << pin;
+		}
+
+		if(io_set_mask_x(error, info, batch->mask[io], pins) != io_ok)
+			return(io_error);
+	}
+
+	io_write_batch_init(batch);
+
+	return(io_ok);
+}
+
+static io_error_t io_trigger_pin_x(string_t *errormsg, const io_info_entry_t *info, io_data_pin_entry_t *pin_data, io_config_pin_entry_t *pin_config, int pin, io_trigger_t trigger_type)
+{
+	io_error_t error;
+
+	error = io_trigger_pin_action(errormsg, info, pin_data, pin_config, pin, trigger_type);
+
+	io_active_pin_update(info->id, pin);
+
+	return(error);
+}
+
 io_error_t io_trigger_pin(string_t *error, unsigned int io, unsigned int pin, io_trigger_t trigger_type)
 {
 	const io_info_entry_t *info;
@@ -1112,6 +1354,256 @@ io_error_t io_traits(string_t *errormsg, unsigned int io, unsigned int pin, io_p
 	return(io_ok);
 }
 
+// returns the partner of a pair's "a" pin
+
+static bool io_renc_pair(unsigned int io, unsigned int pin, unsigned int *partner)
+{
+	const io_config_pin_entry_t *pin_config;
+
+	pin_config = &io_config[io][pin];
+
+	if((pin_config->mode != io_pin_rotary_encoder) ||
+			((pin_config->shared.renc.pin_type != io_renc_1a) && (pin_config->shared.renc.pin_type != io_renc_2a)))
+		return(false);
+
+	*partner = pin_config->shared.renc.partner;
+
+	if((*partner == pin) || (*partner >= io_info[io]->pins) ||
+			(io_config[io][*partner].mode != io_pin_rotary_encoder) ||
+			(io_config[io][*partner].shared.renc.partner != pin))
+		return(false);
+
+	return(true);
+}
+
+static void io_renc_setup(void)
+{
+	io_renc_state_t *encoder;
+	unsigned int io, pin, partner, pairs;
+
+	ets_isr_mask(1 << ETS_GPIO_INUM);
+
+	io_renc.count = 0;
+	free(io_renc.encoder);
+	io_renc.encoder = (io_renc_state_t *)0;
+
+	for(io = 0, pairs = 0; io < io_id_size; io++)
+	{
+		io_renc.pins[io] = 0;
+
+		if(!io_data[io].detected)
+			continue;
+
+		for(pin = 0; pin < io_info[io]->pins; pin++)
+			if(io_renc_pair(io, pin, &partner))
+				pairs++;
+	}
+
+	if(!pairs)
+		goto done;
+
+	if(!(io_renc.encoder = malloc(pairs * sizeof(*io_renc.encoder))))
+	{
+		log("io: rotary encoders: out of memory\n");
+		goto done;
+	}
+
+	for(io = 0; io < io_id_size; io++)
+	{
+		if(!io_data[io].detected)
+			continue;
+
+		for(pin = 0; (pin < io_info[io]->pins) && (io_renc.count < pairs); pin++)
+		{
+			if(!io_renc_pair(io, pin, &partner))
+				continue;
+
+			encoder = &io_renc.encoder[io_renc.count++];
+
+			encoder->io = io;
+			encoder->pin_a = (pin < partner) ? pin : partner;
+			encoder->pin_b = (pin < partner) ? partner : pin;
+			encoder->pin_config = pin;
+			encoder->state = 0;
+			encoder->state_valid = 0;
+			encoder->steps = 0;
+			encoder->last_us = 0;
+			encoder->velocity = 0;
+
+			io_renc.pins[io] |= (1 << pin) | (1 << partner);
+		}
+	}
+
+done:
+	ets_isr_unmask(1 << ETS_GPIO_INUM);
+}
+
+iram uint32_t io_renc_decode(unsigned int io, uint32_t pin_status_mask, uint32_t pin_value_mask)
+{
+	io_renc_state_t *encoder;
+	unsigned int index, state;
+	int step;
+	bool stepped = false;
+
+	if((io >= io_id_size) || !(pin_status_mask & io_renc.pins[io]))
+		return(0);
+
+	for(index = 0; index < io_renc.count; index++)
+	{
+		encoder = &io_renc.encoder[index];
+
+		if((encoder->io != io) || !(pin_status_mask & ((1 << encoder->pin_a) | (1 << encoder->pin_b))))
+			continue;
+
+		state = ((!!(pin_value_mask & (1 << encoder->pin_a))) << 1) | ((!!(pin_value_mask & (1 << encoder->pin_b))) << 0);
+
+		if(encoder->state_valid)
+		{
+			if((step = io_renc_transition[(encoder->state << 2) | state]) != 0)
+			{
+				encoder->steps += step;
+				stepped = true;
+			}
+			else
+				if((encoder->state ^ state) == 0b11)
+					stat_renc_invalid_state++;
+		}
+
+		encoder->state = state;
+		encoder->state_valid = 1;
+	}
+
+	if(stepped && !io_renc.pending)
+	{
+		io_renc.pending = true;
+		dispatch_post_task(task_prio_medium, task_rotary_encoder, 0, 0, 0);
+	}
+
+	return(pin_status_mask & io_renc.pins[io]);
+}
+
+static void io_renc_apply(const io_config_pin_entry_t *pin_config, int steps, unsigned int multiplier)
+{
+	const io_config_pin_entry_t *target_config;
+	io_trigger_t action;
+	unsigned int count, value, lower, upper, max, delta;
+	int target_io, target_pin, remote;
+
+	target_io = pin_config->shared.renc.trigger_pin.io;
+	target_pin = pin_config->shared.renc.trigger_pin.pin;
+	remote = pin_config->shared.renc.trigger_pin.remote;
+
+	if((target_io < 0) || (target_pin < 0))
+		return;
+
+	action = (steps > 0) ? io_trigger_up : io_trigger_down;
+	count = (steps > 0) ? steps : 0 - steps;
+
+	if(remote >= 0)
+	{
+		if(count > io_renc_triggers_max)
+			count = io_renc_triggers_max;
+
+		for(; count > 0; count--)
+			remote_trigger_add((unsigned int)remote, target_io, target_pin, action);
+
+		return;
+	}
+
+	if((target_io >= io_id_size) || (target_pin >= (int)io_info[target_io]->pins))
+		return;
+
+	target_config = &io_config[target_io][target_pin];
+
+	// pwm targets (including ledpixels) are set directly, the step is scaled by the encoder's velocity
+
+	if((target_config->mode == io_pin_output_pwm1) || (target_config->mode == io_pin_output_pwm2))
+	{
+		if(io_read_pin((string_t *)0, target_io, target_pin, &value) != io_ok)
+			return;
+
+		lower = target_config->shared.output_pwm.lower_bound;
+		upper = target_config->shared.output_pwm.upper_bound;
+
+		if(upper > (max = io_pin_max_value(target_io, target_pin)))
+			upper = max;
+
+		if(target_config->static_flags & io_flag_static_linear)
+			delta = target_config->speed;
+		else
+			delta = (value * target_config->speed) / 10000;
+
+		if(delta == 0)
+			delta = 1;
+
+		delta *= count * multiplier;
+
+		if(action == io_trigger_up)
+			value = ((value < upper) && ((upper - value) > delta)) ? value + delta : upper;
+		else
+			value = ((value > lower) && ((value - lower) > delta)) ? value - delta : lower;
+
+		io_write_pin((string_t *)0, target_io, target_pin, value);
+
+		return;
+	}
+
+	count *= multiplier;
+
+	if(count > io_renc_triggers_max)
+		count = io_renc_triggers_max;
+
+	for(; count > 0; count--)
+		io_trigger_pin((string_t *)0, target_io, target_pin, action);
+}
+
+void io_renc_process(void)
+{
+	io_renc_state_t *encoder;
+	const io_config_pin_entry_t *pin_config;
+	unsigned int index, count, elapsed, multiplier;
+	uint32_t now;
+	int steps;
+
+	io_renc.pending = false;
+	now = (uint32_t)time_get_us();
+
+	for(index = 0; index < io_renc.count; index++)
+	{
+		encoder = &io_renc.encoder[index];
+
+		ets_isr_mask(1 << ETS_GPIO_INUM);
+		steps = encoder->steps;
+		encoder->steps = 0;
+		ets_isr_unmask(1 << ETS_GPIO_INUM);
+
+		if(steps == 0)
+			continue;
+
+		count = (steps > 0) ? steps : 0 - steps;
+
+		// smoothed velocity in steps per second, restart from standstill after the encoder has been idle
+
+		elapsed = now - encoder->last_us;
+		encoder->last_us = now;
+
+		if(elapsed > io_renc_idle_us)
+			encoder->velocity = 0;
+		else
+			encoder->velocity = (encoder->velocity + ((count * 1000000) / (elapsed ? elapsed : 1))) / 2;
+
+		pin_config = &io_config[encoder->io][encoder->pin_config];
+		io_data[encoder->io].pin[encoder->pin_config].value += count;
+
+		if(pin_config->static_flags & io_flag_static_invert)
+			steps = 0 - steps;
+
+		multiplier = 1 + ((encoder->velocity * pin_config->speed) / 1000);
+
+		io_renc_apply(pin_config, steps, multiplier);
+	}
+}
+
 void io_init(void)
 {
 	string_new(, error, 64);
@@ -1130,6 +1622,8 @@ void io_init(void)
 	unsigned int spi_pin;
 	uint64_t start = time_get_us();
 
+	gamma_init();
+
 	for(io = 0; io < io_id_size; io++)
 	{
 		info = io_info[io];
@@ -1183,7 +1677,7 @@ void io_init(void)
 			{
 				case(io_pin_rotary_encoder):
 				{
-					unsigned int pin_type;
+					unsigned int pin_type, acceleration;
 					int remote_index;
 
 					if(!config_get_uint("io.%u.%u.renc.pintype", &pin_type, io, pin))
@@ -1193,6 +1687,11 @@ void io_init(void)
 						continue;
 					}
 
+					if(!config_get_uint("io.%u.%u.renc.acceleration", &acceleration, io, pin))
+						acceleration = 0;
+
+					pin_config->speed = acceleration;
+
 					if((pin_type == io_renc_1b) || (pin_type == io_renc_2b))
 					{
 						unsigned int partner_pin;
@@ -1409,6 +1908,8 @@ void io_init(void)
 
 				case(io_pin_ledpixel):
 				{
+					unsigned int pixels;
+
 					if(!(info->caps & caps_ledpixel) || (io_ledpixel_mode(io, pin) == ledpixel_invalid))
 					{
 						pin_config->mode = io_pin_disabled;
@@ -1416,6 +1917,11 @@ void io_init(void)
 						continue;
 					}
 
+					if(!config_get_uint("io.%u.%u.ledpixel.pixels", &pixels, io, pin))
+						pixels = 0;
+
+					pin_config->speed = pixels;
+
 					break;
 				}
 
@@ -1457,6 +1963,29 @@ void io_init(void)
 					break;
 				}
 
+				case(io_pin_frequency):
+				{
+					unsigned int gate, average;
+
+					if((io != io_id_gpio) || !(info->caps & caps_counter))
+					{
+						pin_config->mode = io_pin_disabled;
+						pin_config->llmode = io_pin_ll_disabled;
+						continue;
+					}
+
+					if(!config_get_uint("io.%u.%u.frequency.gate", &gate, io, pin))
+						gate = io_frequency_gate_default;
+
+					if(!config_get_uint("io.%u.%u.frequency.average", &average, io, pin))
+						average = 1;
+
+					pin_config->speed = gate;
+					pin_config->shared.frequency.average = average;
+
+					break;
+				}
+
 				default:
 				{
 					break;
@@ -1541,6 +2070,8 @@ void io_init(void)
 						}
 					}
 				}
+
+				io_active_pin_update(io, pin);
 			}
 		}
 
@@ -1550,6 +2081,10 @@ void io_init(void)
 
 	sequencer_init();
 	remote_trigger_init();
+	io_event_init();
+	io_renc_setup();
+	rules_init();
+	ledpixel_effect_init();
 
 	stat_init_io_time_us = time_get_us() - start;
 }
@@ -1559,11 +2094,6 @@ void io_pin_changed(unsigned int io, unsigned int pin, uint32_t pin_value_mask)
 	const io_config_pin_entry_t *pin_config;
 	io_data_pin_entry_t *pin_data;
 	unsigned int trigger;
-	int remote_trigger;
-	unsigned int partner_pin;
-	unsigned int primary_pin, secondary_pin;
-	unsigned int state;
-	io_trigger_t trigger_action;
 
 	if(io >= io_id_size)
 	{
@@ -1586,6 +2116,8 @@ void io_pin_changed(unsigned int io, unsigned int pin, uint32_t pin_value_mask)
 	pin_config = &io_config[io][pin];
 	pin_data = &io_data[io].pin[pin];
 
+	rules_pin_changed(io, pin, !!(pin_value_mask & (1 << pin)) != !!(pin_config->static_flags & io_flag_static_invert));
+
 	switch(pin_config->mode)
 	{
 		case(io_pin_counter):
@@ -1641,105 +2173,95 @@ void io_pin_changed(unsigned int io, unsigned int pin, uint32_t pin_value_mask)
 			break;
 		}
 
-		case(io_pin_rotary_encoder):
+		default:
 		{
-			partner_pin = pin_config->shared.renc.partner;
+			log("[io] pin change on invalid pin type: %u\n", pin);
+			log("   io: %u pin: %u value mask: %x\n", io, pin, pin_value_mask);
+			break;
+		}
+	}
 
-			if(partner_pin >= io_pin_size)
-			{
-				log("[io] pin_change: invalid partner pin\n");
-				break;
-			}
+	if((pcint_alert.io >= 0) && (pcint_alert.pin >= 0))
+		io_trigger_pin((string_t *)0, pcint_alert.io, pcint_alert.pin, io_trigger_on);
 
-			if(pin > partner_pin)
-			{
-				primary_pin = partner_pin;
-				secondary_pin = pin;
-			}
-			else
-			{
-				primary_pin = pin;
-				secondary_pin = partner_pin;
-			}
+	pin_data->previous = !!(pin_value_mask & (1 << pin));
+}
 
-			state =
-				(io_data[io].pin[primary_pin].previous << 3) |
-				(io_data[io].pin[secondary_pin].previous << 2) |
-				((!!(pin_value_mask & (1 << primary_pin))) << 1) |
-				((!!(pin_value_mask & (1 << secondary_pin))) << 0);
+static void io_frequency_gate(unsigned int pin, const io_config_pin_entry_t *pin_config, io_data_pin_entry_t *pin_data)
+{
+	unsigned int periods, average;
+	uint32_t high;
+	uint64_t span, idle_us, cpu_hz, frequency, duty;
 
-			trigger_action = io_trigger_none;
+	if(!io_gpio_frequency_sample(pin, &periods, &span, &high, &idle_us))
+		return;
 
-			switch(state)
-			{
-				case(0b1101):
-				case(0b0100):
-				case(0b0010):
-				case(0b1011):
-				{
-					if(pin_config->static_flags & io_flag_static_invert)
-						trigger_action = io_trigger_down;
-					else
-						trigger_action = io_trigger_up;
-					break;
-				}
+	cpu_hz = system_get_cpu_freq() * 1000000ULL;
 
-				case(0b1000):
-				case(0b0001):
-				case(0b0111):
-				case(0b1110):
-				{
-					if(pin_config->static_flags & io_flag_static_invert)
-						trigger_action = io_trigger_up;
-					else
-						trigger_action = io_trigger_down;
-					break;
-				}
+	if((periods == 0) || (span == 0))
+	{
+		// no complete period in this gate, only drop to zero after two periods without a rising edge,
+		// value is in mHz, so two periods are 2 * 10^9 / value us
 
-				default:
-				{
-#if 0
-					string_new(, state_string, 32);
-					string_clear(&state_string);
-					string_word_to_bin(&state_string, state, 4);
-					log("invalid state: %s\n", string_to_cstr(&state_string));
-#endif
-					stat_renc_invalid_state++;
-					break;
-				}
-			}
+		if(pin_data->value && (idle_us < 2000000000ULL) && ((idle_us * pin_data->value) < 2000000000ULL))
+			return;
 
-			if(trigger_action != io_trigger_none)
-			{
-				pin_data->value++;
+		pin_data->value = 0;
+		pin_data->saved_value = 0;
+		return;
+	}
 
-				if((remote_trigger = pin_config->shared.renc.trigger_pin.remote) >= 0)
-					remote_trigger_add((unsigned int)remote_trigger,
-							pin_config->shared.renc.trigger_pin.io,
-							pin_config->shared.renc.trigger_pin.pin,
-							trigger_action);
-				else
-					io_trigger_pin((string_t *)0,
-							pin_config->shared.renc.trigger_pin.io,
-							pin_config->shared.renc.trigger_pin.pin,
-							trigger_action);
-			}
+	// reciprocal measurement: whole periods over the ccount span between their rising edges, in mHz and 0.01 %
 
-			break;
-		}
+	frequency = (periods * cpu_hz * 1000) / span;
+	duty = (high * 10000ULL) / span;
 
-		default:
-		{
-			log("[io] pin change on invalid pin type: %u\n", pin);
-			log("   io: %u pin: %u value mask: %x\n", io, pin, pin_value_mask);
-			break;
-		}
+	if(frequency > 0xffffffffULL)
+		frequency = 0xffffffffULL;
+
+	if(duty > 10000)
+		duty = 10000;
+
+	average = pin_config->shared.frequency.average;
+
+	if((average > 1) && (pin_data->value > 0))
+	{
+		frequency = ((pin_data->value * (uint64_t)(average - 1)) + frequency) / average;
+		duty = ((pin_data->saved_value * (uint64_t)(average - 1)) + duty) / average;
 	}
 
-	if((pcint_alert.io >= 0) && (pcint_alert.pin >= 0))
-		io_trigger_pin((string_t *)0, pcint_alert.io, pcint_alert.pin, io_trigger_on);
+	pin_data->value = (uint32_t)frequency;
+	pin_data->saved_value = (uint32_t)duty;
+}
 
-	pin_data->previous = !!(pin_value_mask & (1 << pin));
+static void io_frequency_format(string_t *dst, const io_config_pin_entry_t *pin_config, const io_data_pin_entry_t *pin_data)
+{
+	unsigned int period_us;
+
+	period_us = pin_data->value ? (unsigned int)(1000000000ULL / pin_data->value) : 0;
+
+	string_format(dst, "frequency: %u.%03u Hz, period: %u us, duty: %u.%02u %%, gate: %u ms, average: %u",
+			(unsigned int)(pin_data->value / 1000), (unsigned int)(pin_data->value % 1000), period_us,
+			(unsigned int)(pin_data->saved_value / 100), (unsigned int)(pin_data->saved_value % 100),
+			(unsigned int)pin_config->speed, (unsigned int)pin_config->shared.frequency.average);
+}
+
+void io_frequency_dump(string_t *dst)
+{
+	unsigned int pin;
+
+	if(!io_data[io_id_gpio].detected)
+		return;
+
+	for(pin = 0; pin < io_info[io_id_gpio]->pins; pin++)
+	{
+		if(io_config[io_id_gpio][pin].mode != io_pin_frequency)
+			continue;
+
+		string_format(dst, "sensor io %u/%02u: gpio, ", (unsigned int)io_id_gpio, pin);
+		io_frequency_format(dst, &io_config[io_id_gpio][pin], &io_data[io_id_gpio].pin[pin]);
+		string_append(dst, "\n");
+	}
 }
 
 iram void io_periodic_fast(unsigned int rate_ms)
@@ -1748,7 +2270,7 @@ iram void io_periodic_fast(unsigned int rate_ms)
 	io_data_entry_t *data;
 	io_config_pin_entry_t *pin_config;
 	io_data_pin_entry_t *pin_data;
-	unsigned int io, pin;
+	unsigned int io, pin, index;
 	io_trigger_t trigger_action;
 
 	for(io = 0; io < io_id_size; io++)
@@ -1756,88 +2278,99 @@ iram void io_periodic_fast(unsigned int rate_ms)
 		info = io_info[io];
 		data = &io_data[io];
 
-		if(!data->detected)
-			continue;
-
-		if(info->periodic_fast_fn)
+		if(data->detected && info->periodic_fast_fn)
 			info->periodic_fast_fn(io, info, data, rate_ms);
+	}
 
-		for(pin = 0; pin < info->pins; pin++)
-		{
-			pin_config = &io_config[io][pin];
-			pin_data = &data->pin[pin];
+	ledpixel_effect_periodic(rate_ms);
 
-			switch(pin_config->mode)
+	// walk backwards, pins that become inactive are replaced by the (already serviced) last entry
+
+	for(index = io_active_pins.count; index > 0; index--)
+	{
+		io = io_active_pins.entry[index - 1].io;
+		pin = io_active_pins.entry[index - 1].pin;
+
+		info = io_info[io];
+		pin_config = &io_config[io][pin];
+		pin_data = &io_data[io].pin[pin];
+
+		switch(pin_config->mode)
+		{
+			case(io_pin_timer):
 			{
-				case(io_pin_timer):
+				if(pin_data->speed > rate_ms)
+					pin_data->speed -= rate_ms;
+				else
 				{
-					if(pin_data->direction != io_dir_none)
+					pin_data->speed = 0;
+
+					switch(pin_data->direction)
 					{
-						if(pin_data->speed > rate_ms)
-							pin_data->speed -= rate_ms;
-						else
+						case(io_dir_up):
 						{
-							pin_data->speed = 0;
+							info->write_pin_fn((string_t *)0, info, pin_data, pin_config, pin, 1);
+							pin_data->direction = io_dir_down;
+							break;
+						}
 
-							switch(pin_data->direction)
-							{
-								case(io_dir_up):
-								{
-									info->write_pin_fn((string_t *)0, info, pin_data, pin_config, pin, 1);
-									pin_data->direction = io_dir_down;
-									break;
-								}
-
-								case(io_dir_down):
-								{
-									info->write_pin_fn((string_t *)0, info, pin_data, pin_config, pin, 0);
-									pin_data->direction = io_dir_up;
-									break;
-								}
-
-								case(io_dir_none):
-								{
-									break;
-								}
-							}
+						case(io_dir_down):
+						{
+							info->write_pin_fn((string_t *)0, info, pin_data, pin_config, pin, 0);
+							pin_data->direction = io_dir_up;
+							break;
+						}
 
-							if(pin_config->static_flags & io_flag_static_repeat)
-								pin_data->speed = pin_config->speed;
-							else
-							{
-								pin_data->speed = 0;
-								pin_data->direction = io_dir_none;
-							}
+						case(io_dir_none):
+						{
+							break;
 						}
 					}
 
-					break;
-				}
-
-				case(io_pin_output_pwm1):
-				case(io_pin_output_pwm2):
-				{
-					if((pin_config->shared.output_pwm.upper_bound > pin_config->shared.output_pwm.lower_bound) &&
-							(pin_config->speed > 0) &&
-							(pin_data->direction != io_dir_none))
+					if(pin_config->static_flags & io_flag_static_repeat)
+						pin_data->speed = pin_config->speed;
+					else
 					{
-						trigger_action = (pin_data->direction == io_dir_up) ? io_trigger_up : io_trigger_down;
-						io_trigger_pin((string_t *)0, io, pin, trigger_action);
+						pin_data->speed = 0;
+						pin_data->direction = io_dir_none;
 					}
-
-					break;
 				}
 
-				default:
+				break;
+			}
+
+			case(io_pin_output_pwm1):
+			case(io_pin_output_pwm2):
+			{
+				trigger_action = (pin_data->direction == io_dir_up) ? io_trigger_up : io_trigger_down;
+				io_trigger_pin((string_t *)0, io, pin, trigger_action);
+
+				break;
+			}
+
+			case(io_pin_frequency):
+			{
+				if(pin_data->speed > rate_ms)
+					pin_data->speed -= rate_ms;
+				else
 				{
-					break;
+					pin_data->speed = pin_config->speed;
+					io_frequency_gate(pin, pin_config, pin_data);
 				}
+
+				break;
+			}
+
+			default:
+			{
+				break;
 			}
 		}
+
+		io_active_pin_update(io, pin);
 	}
 
-	if((sequencer_get_repeats() > 0) && ((time_get_us() / 1000) > sequencer_get_current_end_time()))
-		dispatch_post_task(task_prio_high, task_run_sequencer, 0, 0, 0);
+	sequencer_periodic();
 }
 
 void io_periodic_slow(unsigned int rate_ms)
@@ -1863,6 +2396,9 @@ void io_periodic_slow(unsigned int rate_ms)
 			info->periodic_slow_fn(io, info, data, rate_ms);
 	}
 
+	io_event_periodic();
+	rules_periodic();
+
 	post_init_run = true;
 }
 
@@ -1985,6 +2521,7 @@ app_action_t application_function_io_mode(app_params_t *parameters)
 			io_renc_pin_t pin_type;
 			int trigger_remote_index = -1;
 			unsigned int partner_pin;
+			unsigned int acceleration = 0;
 
 			if(!(info->caps & caps_rotary_encoder))
 			{
@@ -2002,7 +2539,7 @@ app_action_t application_function_io_mode(app_params_t *parameters)
 
 			if((parse_int(5, parameters->src, &trigger_io, 0, ' ') == parse_ok) && (parse_int(6, parameters->src, &trigger_pin, 0, ' ') == parse_ok))
 				if(parse_int(7, parameters->src, &trigger_remote_index, 0, ' ') == parse_ok)
-					(void)0;
+					parse_uint(8, parameters->src, &acceleration, 0, ' ');
 				else
 					trigger_remote_index = -1;
 			else
@@ -2030,6 +2567,7 @@ app_action_t application_function_io_mode(app_params_t *parameters)
 				trigger_io = io_config[io][partner_pin].shared.renc.trigger_pin.io;
 				trigger_pin = io_config[io][partner_pin].shared.renc.trigger_pin.pin;
 				trigger_remote_index = io_config[io][partner_pin].shared.renc.trigger_pin.remote;
+				acceleration = io_config[io][partner_pin].speed;
 				pin_config->shared.renc.partner = partner_pin;
 			}
 
@@ -2037,6 +2575,7 @@ app_action_t application_function_io_mode(app_params_t *parameters)
 			pin_config->shared.renc.trigger_pin.remote = trigger_remote_index;
 			pin_config->shared.renc.trigger_pin.io = trigger_io;
 			pin_config->shared.renc.trigger_pin.pin = trigger_pin;
+			pin_config->speed = acceleration;
 			llmode = io_pin_ll_counter;
 
 			config_delete("io.%u.%u.", true, io, pin);
@@ -2047,6 +2586,9 @@ app_action_t application_function_io_mode(app_params_t *parameters)
 			if(trigger_remote_index >= 0)
 				config_set_int("io.%u.%u.renc.remote", trigger_remote_index, io, pin);
 
+			if(acceleration > 0)
+				config_set_int("io.%u.%u.renc.acceleration", acceleration, io, pin);
+
 			if((trigger_io >= 0) && (trigger_pin >= 0))
 			{
 				config_set_int("io.%u.%u.renc.trigger_pin.io", trigger_io, io, pin);
@@ -2056,7 +2598,7 @@ app_action_t application_function_io_mode(app_params_t *parameters)
 			break;
 renc_error:
 			string_clear(parameters->dst);
-			string_append(parameters->dst, "rotary encoder: <pin mode> [<trigger io> <trigger pin> [<remote index>]], <pin mode>=1a|1b|2a|2b\n");
+			string_append(parameters->dst, "rotary encoder: <pin mode> [<trigger io> <trigger pin> [<remote index> [<acceleration>]]], <pin mode>=1a|1b|2a|2b\n");
 renc_error1:
 			config_abort_write();
 			return(app_action_error);
@@ -2476,6 +3018,8 @@ skip:
 
 		case(io_pin_ledpixel):
 		{
+			unsigned int pixels = 0;
+
 			if(!(info->caps & caps_ledpixel))
 			{
 				config_abort_write();
@@ -2483,10 +3027,19 @@ skip:
 				return(app_action_error);
 			}
 
+			parse_uint(4, parameters->src, &pixels, 0, ' ');
+
 			switch(io_ledpixel_mode(io, pin))
 			{
 				case(ledpixel_i2s):
 				{
+					if(pixels > ledpixel_fb_pixels_max)
+					{
+						config_abort_write();
+						string_format(parameters->dst, "ledpixel: [<framebuffer pixels> 0-%u]\n", ledpixel_fb_pixels_max);
+						return(app_action_error);
+					}
+
 					llmode = io_pin_ll_i2s;
 					break;
 				}
@@ -2506,10 +3059,22 @@ skip:
 				}
 			}
 
+			if((llmode != io_pin_ll_i2s) && (pixels > 0))
+			{
+				config_abort_write();
+				string_append(parameters->dst, "ledpixel framebuffer only available on the i2s pin\n");
+				return(app_action_error);
+			}
+
+			pin_config->speed = pixels;
+
 			config_delete("io.%u.%u.", true, io, pin);
 			config_set_int("io.%u.%u.mode", mode, io, pin);
 			config_set_int("io.%u.%u.llmode", llmode, io, pin);
 
+			if(pixels > 0)
+				config_set_int("io.%u.%u.ledpixel.pixels", pixels, io, pin);
+
 			break;
 		}
 
@@ -2567,6 +3132,46 @@ skip:
 			break;
 		}
 
+		case(io_pin_frequency):
+		{
+			unsigned int gate = io_frequency_gate_default;
+			unsigned int average = 1;
+
+			if((io != io_id_gpio) || !(info->caps & caps_counter))
+			{
+				config_abort_write();
+				string_append(parameters->dst, "frequency measurement mode invalid for this io\n");
+				return(app_action_error);
+			}
+
+			parse_uint(4, parameters->src, &gate, 0, ' ');
+			parse_uint(5, parameters->src, &average, 0, ' ');
+
+			if((gate < io_frequency_gate_min) || (gate > io_frequency_gate_max) || (average < 1) || (average > io_frequency_average_max))
+			{
+				config_abort_write();
+				string_format(parameters->dst, "frequency: [<gate time ms> %u-%u] [<average over gates> 1-%u]\n",
+						io_frequency_gate_min, io_frequency_gate_max, io_frequency_average_max);
+				return(app_action_error);
+			}
+
+			pin_config->speed = gate;
+			pin_config->shared.frequency.average = average;
+			pin_data->speed = 0;
+			pin_data->value = 0;
+			pin_data->saved_value = 0;
+
+			llmode = io_pin_ll_counter;
+
+			config_delete("io.%u.%u.", true, io, pin);
+			config_set_int("io.%u.%u.mode", mode, io, pin);
+			config_set_int("io.%u.%u.llmode", io_pin_ll_counter, io, pin);
+			config_set_int("io.%u.%u.frequency.gate", gate, io, pin);
+			config_set_int("io.%u.%u.frequency.average", average, io, pin);
+
+			break;
+		}
+
 		case(io_pin_disabled):
 		{
 			llmode = io_pin_ll_disabled;
@@ -2601,9 +3206,14 @@ skip:
 	{
 		pin_config->mode = io_pin_disabled;
 		pin_config->llmode = io_pin_ll_disabled;
+		io_active_pin_update(io, pin);
+		io_renc_setup();
 		return(app_action_error);
 	}
 
+	io_active_pin_update(io, pin);
+	io_renc_setup();
+
 	io_config_dump(parameters->dst, io, pin, false);
 
 	return(app_action_normal);
@@ -2668,7 +3278,15 @@ app_action_t application_function_io_read(app_params_t *parameters)
 	if(io_read_pin(parameters->dst, io, pin, &value) != io_ok)
 		return(app_action_error);
 
-	string_format(parameters->dst, "[%u]\n", value);
+	string_format(parameters->dst, "[%u]", value);
+
+	if(pin_config->mode == io_pin_frequency)
+	{
+		string_append(parameters->dst, " ");
+		io_frequency_format(parameters->dst, pin_config, &io_data[io].pin[pin]);
+	}
+
+	string_append(parameters->dst, "\n");
 
 	return(app_action_normal);
 }
@@ -2737,6 +3355,43 @@ app_action_t application_function_io_write(app_params_t *parameters)
 	return(app_action_normal);
 }
 
+app_action_t application_function_io_write_multi(app_params_t *parameters)
+{
+	io_write_batch_t batch;
+	unsigned int io, pin, value, index;
+
+	io_write_batch_init(&batch);
+
+	for(index = 1; parse_uint(index, parameters->src, &io, 0, ' ') == parse_ok; index += 3)
+	{
+		if((parse_uint(index + 1, parameters->src, &pin, 0, ' ') != parse_ok) ||
+				(parse_uint(index + 2, parameters->src, &value, 0, ' ') != parse_ok))
+		{
+			string_append(parameters->dst, "io-write-multi <io> <pin> <value> [<io> <pin> <value> ...]\n");
+			return(app_action_error);
+		}
+
+		if(io_write_batch_add(parameters->dst, &batch, io, pin, value) != io_ok)
+			return(app_action_error);
+	}
+
+	if(index == 1)
+	{
+		string_append(parameters->dst, "io-write-multi <io> <pin> <value> [<io> <pin> <value> ...]\n");
+		return(app_action_error);
+	}
+
+	if(io_write_batch_flush(parameters->dst, &batch) != io_ok)
+	{
+		string_append(parameters->dst, "error\n");
+		return(app_action_error);
+	}
+
+	string_format(parameters->dst, "ok, %u pins written\n", (index - 1) / 3);
+
+	return(app_action_normal);
+}
+
 app_action_t application_function_io_set_mask(app_params_t *parameters)
 {
 	unsigned int io, mask, pins;
@@ -3048,6 +3703,8 @@ typedef enum
 	ds_id_lcd,
 	ds_id_spi,
 	ds_id_pcint,
+	ds_id_frequency_1,
+	ds_id_frequency_2,
 	ds_id_unknown,
 	ds_id_max_value,
 	ds_id_info_1,
@@ -3086,7 +3743,7 @@ static const roflash dump_string_t roflash_dump_strings =
 		/* ds_id_input_analog */	"value: %s",
 		/* ds_id_counter */			"counter: %d",
 		/* ds_id_rotary_encoder_1 */"pin ",
-		/* ds_id_rotary_encoder_2 */", counter: %d, partner pin: %u, trigger io: %d, pin: %d, remote: %d",
+		/* ds_id_rotary_encoder_2 */", counter: %d, partner pin: %u, trigger io: %d, pin: %d, remote: %d, acceleration: %u",
 		/* ds_id_trigger_1 */		"trigger, counter: %d\n",
 		/* ds_id_trigger_2 */		"             action #%d: io: %d, pin: %d, action: ",
 		/* ds_id_trigger_3 */		"",
@@ -3097,11 +3754,13 @@ static const roflash dump_string_t roflash_dump_strings =
 		/* ds_id_i2c_sda */			"sda",
 		/* ds_id_i2c_scl */			"scl",
 		/* ds_id_uart */			"uart",
-		/* ds_id_ledpixel */		"ledpixel",
+		/* ds_id_ledpixel */		"ledpixel, framebuffer pixels: %u",
 		/* ds_id_cfa634 */			"cfa634",
 		/* ds_id_lcd */				"lcd",
 		/* ds_id_spi */				"spi",
 		/* ds_id_pcint */			"pcint, counter: %u",
+		/* ds_id_frequency_1 */		"",
+		/* ds_id_frequency_2 */		"",
 		/* ds_id_unknown */			"unknown",
 		/* ds_id_max_value */		", max value: %u",
 		/* ds_id_info_1 */			", info: ",
@@ -3128,7 +3787,7 @@ static const roflash dump_string_t roflash_dump_strings =
 		/* ds_id_input_analog */	"<td>value: %s</td>",
 		/* ds_id_counter */			"<td><td>counter: %d</td>",
 		/* ds_id_rotary_encoder_1 */"<td>pin ",
-		/* ds_id_rotary_encoder_2 */", counter: %d, partner pin: %u, trigger io: %d, pin: %d, remote: %d</td>",
+		/* ds_id_rotary_encoder_2 */", counter: %d, partner pin: %u, trigger io: %d, pin: %d, remote: %d, acceleration: %u</td>",
 		/* ds_id_trigger_1 */		"<td>counter: %d, ",
 		/* ds_id_trigger_2 */		"action: #%d, io: %d, pin: %d, trigger action: ",
 		/* ds_id_trigger_3 */		"</td>",
@@ -3139,11 +3798,13 @@ static const roflash dump_string_t roflash_dump_strings =
 		/* ds_id_i2c_sda */			"<td>sda</td>",
 		/* ds_id_i2c_scl */			"<td>scl</td>",
 		/* ds_id_uart */			"<td>uart</td>",
-		/* ds_id_ledpixel */		"<td>ledpixel</td>",
+		/* ds_id_ledpixel */		"<td>ledpixel, framebuffer pixels: %u</td>",
 		/* ds_id_cfa634 */			"<td>cfa634</td>",
 		/* ds_id_lcd */				"<td>lcd</td>",
 		/* ds_id_spi */				"<td>spi</td>",
 		/* ds_id_pcint */			"<td>pcint, counter: %u</td>",
+		/* ds_id_frequency_1 */		"<td>",
+		/* ds_id_frequency_2 */		"</td>",
 		/* ds_id_unknown */			"<td>unknown</td>",
 		/* ds_id_max_value */		"<td>%u</td>",
 		/* ds_id_info_1 */			"<td>",
@@ -3221,6 +3882,7 @@ void io_config_dump(string_t *dst, int io_id, int pin_id, bool html)
 				case(io_pin_trigger):
 				case(io_pin_rotary_encoder):
 				case(io_pin_pcint):
+				case(io_pin_frequency):
 				case(io_pin_output_digital):
 				case(io_pin_timer):
 				case(io_pin_input_analog):
@@ -3288,7 +3950,8 @@ void io_config_dump(string_t *dst, int io_id, int pin_id, bool html)
 						string_append_cstr_flash(dst, (*roflash_strings)[ds_id_rotary_encoder_1]);
 						io_string_from_renc_pin(dst, pin_config->shared.renc.pin_type);
 						string_format_flash_ptr(dst, (*roflash_strings)[ds_id_rotary_encoder_2], value, pin_config->shared.renc.partner,
-								pin_config->shared.renc.trigger_pin.io, pin_config->shared.renc.trigger_pin.pin, pin_config->shared.renc.trigger_pin.remote);
+								pin_config->shared.renc.trigger_pin.io, pin_config->shared.renc.trigger_pin.pin, pin_config->shared.renc.trigger_pin.remote,
+								(unsigned int)pin_config->speed);
 					}
 					else
 						string_append_cstr_flash(dst, (*roflash_strings)[ds_id_error]);
@@ -3405,7 +4068,7 @@ void io_config_dump(string_t *dst, int io_id, int pin_id, bool html)
 
 				case(io_pin_ledpixel):
 				{
-					string_append_cstr_flash(dst, (*roflash_strings)[ds_id_ledpixel]);
+					string_format_flash_ptr(dst, (*roflash_strings)[ds_id_ledpixel], (unsigned int)pin_config->speed);
 
 					break;
 				}
@@ -3431,6 +4094,20 @@ void io_config_dump(string_t *dst, int io_id, int pin_id, bool html)
 					break;
 				}
 
+				case(io_pin_frequency):
+				{
+					if(error == io_ok)
+					{
+						string_append_cstr_flash(dst, (*roflash_strings)[ds_id_frequency_1]);
+						io_frequency_format(dst, pin_config, pin_data);
+						string_append_cstr_flash(dst, (*roflash_strings)[ds_id_frequency_2]);
+					}
+					else
+						string_append_cstr_flash(dst, (*roflash_strings)[ds_id_error]);
+
+					break;
+				}
+
 				case(io_pin_error):
 				{
 					string_append_cstr_flash(dst, (*roflash_strings)[ds_id_unknown]);
@@ -91,12 +91,21 @@ typedef enum
 	io_pin_rotary_encoder,
 	io_pin_spi,
 	io_pin_pcint,
+	io_pin_frequency,
 	io_pin_error,
 	io_pin_size = io_pin_error,
 } io_pin_mode_t;
 
 assert_size(io_pin_mode_t, 4);
 
+enum
+{
+	io_frequency_gate_min = 10,
+	io_frequency_gate_max = 20000, // ccount wraps after ~26 s at 160 MHz
+	io_frequency_gate_default = 1000,
+	io_frequency_average_max = 255,
+};
+
 typedef enum
 {
 	io_flag_static_none =			0 << 0,
@@ -258,6 +267,11 @@ typedef struct attr_packed
 			io_lcd_mode_t pin_use;
 		} lcd;
 
+		struct attr_packed
+		{
+			unsigned int average:8;
+		} frequency;
+
 		struct attr_packed
 		{
 			io_renc_pin_t	pin_type:8;
@@ -305,22 +319,36 @@ assert_size(io_info_entry_t, 68);
 
 extern io_config_pin_entry_t io_config[io_id_size][max_pins_per_io];
 
+typedef struct
+{
+	uint16_t	mask[io_id_size];
+	uint16_t	value[io_id_size];
+} io_write_batch_t;
+
 void			io_init(void);
 void			io_pin_changed(unsigned int io, unsigned int pin, uint32_t pin_value_mask);
+uint32_t		io_renc_decode(unsigned int io, uint32_t pin_status_mask, uint32_t pin_value_mask);
+void			io_renc_process(void);
 void			io_periodic_slow(unsigned int period);
 void			io_periodic_fast(unsigned int period);
 unsigned int	io_pin_max_value(unsigned int io, unsigned int pin);
 io_error_t		io_read_pin(string_t *, unsigned int, unsigned int, unsigned int *);
 io_error_t		io_write_pin(string_t *, unsigned int, unsigned int, unsigned int);
 io_error_t		io_set_mask(string_t *error, int io, unsigned int mask, unsigned int pins);
+void			io_write_batch_init(io_write_batch_t *batch);
+io_error_t		io_write_batch_add(string_t *error, io_write_batch_t *batch, unsigned int io, unsigned int pin, unsigned int value);
+io_error_t		io_write_batch_flush(string_t *error, io_write_batch_t *batch);
 io_error_t		io_trigger_pin(string_t *, unsigned int, unsigned int, io_trigger_t);
+io_trigger_t	string_to_trigger_action(const string_t *src);
 io_error_t		io_traits(string_t *, unsigned int io, unsigned int pin, io_pin_mode_t *mode, unsigned int *lower_bound, unsigned int *upper_bound, int *step, unsigned int *value);
 void			io_config_dump(string_t *dst, int io_id, int pin_id, bool html);
 void			io_string_from_ll_mode(string_t *, io_pin_ll_mode_t, int pad);
+void			io_frequency_dump(string_t *dst);
 
 app_action_t application_function_io_mode(app_params_t *);
 app_action_t application_function_io_read(app_params_t *);
 app_action_t application_function_io_write(app_params_t *);
+app_action_t application_function_io_write_multi(app_params_t *);
 app_action_t application_function_io_trigger(app_params_t *);
 app_action_t application_function_io_set_flag(app_params_t *);
 app_action_t application_function_io_clear_flag(app_params_t *);
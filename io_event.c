@@ -0,0 +1,231 @@
+#include "attribute.h"
+#include "io_event.h"
+#include "io.h"
+#include "lwip-interface.h"
+#include "dispatch.h"
+#include "config.h"
+#include "eagle.h"
+
+// Pin change events are recorded into a ring buffer, from the gpio isr
+// directly and from the mcp/pcf pin change handlers. A subscriber (any
+// peer that sent "subscribe" to the event port, either udp or tcp)
+// receives them as a stream of text lines. The event port is only opened
+// when configured (io.event.port, io-event-port command), because it takes
+// a udp pcb and a tcp listen pcb. The ring can also be read with the
+// io-events command.
+
+typedef struct
+{
+	bool			subscribed;
+	bool			send_posted;
+	uint32_t		next_sequence;
+	uint32_t		sent_sequence;
+	uint32_t		lost;
+	io_event_t		ring[io_event_ring_size];
+} io_event_state_t;
+
+static io_event_state_t state;
+
+string_new(static, io_event_socket_send_buffer, 512);
+string_new(static, io_event_socket_receive_buffer, 32);
+
+static lwip_if_socket_t event_socket;
+
+assert_size(io_event_state_t, 16 + (io_event_ring_size * sizeof(io_event_t)));
+
+iram static void add_entry(uint64_t time_us, unsigned int io, unsigned int pin, unsigned int value)
+{
+	io_event_t *entry = &state.ring[state.next_sequence & (io_event_ring_size - 1)];
+
+	entry->time_low = (uint32_t)(time_us >> 0);
+	entry->time_high = (uint32_t)(time_us >> 32);
+	entry->sequence = state.next_sequence;
+	entry->io = io;
+	entry->pin = pin;
+	entry->value = value;
+	entry->fill = 0;
+
+	state.next_sequence++;
+}
+
+iram static void add_mask(uint64_t time_us, unsigned int io, uint32_t pin_status_mask, uint32_t pin_value_mask)
+{
+	unsigned int pin;
+
+	for(pin = 0; (pin < 16) && pin_status_mask; pin++, pin_status_mask >>= 1)
+		if(pin_status_mask & 0x01)
+			add_entry(time_us, io, pin, !!(pin_value_mask & (1 << pin)));
+
+	if(state.subscribed && !state.send_posted)
+	{
+		state.send_posted = true;
+		dispatch_post_task(task_prio_low, task_io_event_send, 0, 0, 0);
+	}
+}
+
+// call from the gpio isr only
+
+iram void io_event_add_isr(uint64_t time_us, unsigned int io, uint32_t pin_status_mask, uint32_t pin_value_mask)
+{
+	add_mask(time_us, io, pin_status_mask, pin_value_mask);
+}
+
+// call from task context, keeps the gpio isr from interleaving
+
+void io_event_add(uint64_t time_us, unsigned int io, uint32_t pin_status_mask, uint32_t pin_value_mask)
+{
+	ets_isr_mask(1 << ETS_GPIO_INUM);
+	add_mask(time_us, io, pin_status_mask, pin_value_mask);
+	ets_isr_unmask(1 << ETS_GPIO_INUM);
+}
+
+static bool get_entry(uint32_t sequence, io_event_t *entry, uint32_t *next_sequence)
+{
+	bool valid;
+
+	ets_isr_mask(1 << ETS_GPIO_INUM);
+
+	*next_sequence = state.next_sequence;
+	*entry = state.ring[sequence & (io_event_ring_size - 1)];
+
+	ets_isr_unmask(1 << ETS_GPIO_INUM);
+
+	valid = (sequence != *next_sequence) && (entry->sequence == sequence);
+
+	return(valid);
+}
+
+static void format_entry(string_t *dst, const io_event_t *entry)
+{
+	uint64_t time_us = ((uint64_t)entry->time_high << 32) | entry->time_low;
+
+	string_format(dst, "event %u %u.%06u %u %u %u\n",
+			entry->sequence, (unsigned int)(time_us / 1000000), (unsigned int)(time_us % 1000000),
+			entry->io, entry->pin, entry->value);
+}
+
+static void socket_io_event_callback_data_received(lwip_if_socket_t *socket, const lwip_if_callback_context_t *context)
+{
+	if(string_match_cstr(&io_event_socket_receive_buffer, "unsubscribe") || string_match_cstr(&io_event_socket_receive_buffer, "unsubscribe\n"))
+		state.subscribed = false;
+	else
+	{
+		if(!state.subscribed)
+			state.sent_sequence = state.next_sequence;
+
+		state.subscribed = true;
+	}
+
+	string_clear(&io_event_socket_receive_buffer);
+	lwip_if_receive_buffer_unlock(socket, lwip_if_proto_all);
+
+	string_clear(&io_event_socket_send_buffer);
+	string_format(&io_event_socket_send_buffer, "%s %u\n", state.subscribed ? "subscribed" : "unsubscribed", state.next_sequence);
+
+	if(!lwip_if_send(socket))
+		state.subscribed = false;
+}
+
+void io_event_init(void)
+{
+	unsigned int port;
+
+	state.subscribed = false;
+	state.send_posted = false;
+	state.next_sequence = 0;
+	state.sent_sequence = 0;
+	state.lost = 0;
+
+	if(!config_get_uint("io.event.port", &port, -1, -1) || (port == 0))
+		return;
+
+	if(!lwip_if_socket_create(&event_socket, "event", &io_event_socket_receive_buffer, &io_event_socket_send_buffer, port,
+			true, socket_io_event_callback_data_received))
+		log("io event: cannot create socket on port %u\n", port);
+}
+
+void io_event_periodic(void)
+{
+	if(state.subscribed && !state.send_posted && (state.sent_sequence != state.next_sequence))
+	{
+		state.send_posted = true;
+		dispatch_post_task(task_prio_low, task_io_event_send, 0, 0, 0);
+	}
+}
+
+void io_event_send(void)
+{
+	io_event_t entry;
+	uint32_t next_sequence;
+	unsigned int lost;
+
+	state.send_posted = false;
+
+	if(!state.subscribed)
+		return;
+
+	// a previous send is still in progress, io_event_periodic will retry
+
+	if(lwip_if_send_buffer_locked(&event_socket))
+		return;
+
+	string_clear(&io_event_socket_send_buffer);
+
+	while((string_size(&io_event_socket_send_buffer) - string_length(&io_event_socket_send_buffer)) > 48)
+	{
+		if(get_entry(state.sent_sequence, &entry, &next_sequence))
+		{
+			format_entry(&io_event_socket_send_buffer, &entry);
+			state.sent_sequence++;
+			continue;
+		}
+
+		if((next_sequence - state.sent_sequence) <= io_event_ring_size)
+			break;
+
+		// the ring has been overrun since the last send, skip to the oldest entry still present
+
+		lost = next_sequence - state.sent_sequence - io_event_ring_size;
+		state.sent_sequence = next_sequence - io_event_ring_size;
+		state.lost += lost;
+		string_format(&io_event_socket_send_buffer, "lost %u\n", lost);
+	}
+
+	if((string_length(&io_event_socket_send_buffer) > 0) && !lwip_if_send(&event_socket))
+	{
+		log("io event: send failed, unsubscribing\n");
+		state.subscribed = false;
+	}
+}
+
+app_action_t application_function_io_events(app_params_t *parameters)
+{
+	io_event_t entry;
+	uint32_t sequence, next_sequence, oldest;
+	unsigned int from;
+
+	next_sequence = state.next_sequence;
+	oldest = (next_sequence > io_event_ring_size) ? next_sequence - io_event_ring_size : 0;
+
+	if(parse_uint(1, parameters->src, &from, 0, ' ') != parse_ok)
+		from = oldest;
+
+	if((int32_t)(from - oldest) < 0)
+		from = oldest;
+
+	string_format(parameters->dst, "io-events: next: %u, subscribed: %s, lost: %u\n",
+			next_sequence, state.subscribed ? "yes" : "no", state.lost);
+
+	for(sequence = from; (int32_t)(sequence - next_sequence) < 0; sequence++)
+	{
+		if(!get_entry(sequence, &entry, &next_sequence))
+			continue;
+
+		format_entry(parameters->dst, &entry);
+
+		if((string_size(parameters->dst) - string_length(parameters->dst)) < 48)
+			break;
+	}
+
+	return(app_action_normal);
+}
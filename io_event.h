@@ -0,0 +1,36 @@
+#ifndef _io_event_h_
+#define _io_event_h_
+
+#include "util.h"
+#include "dispatch.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+enum
+{
+	io_event_ring_size = 64, // must be power of two
+};
+
+typedef struct
+{
+	uint32_t	time_low;
+	uint32_t	time_high;
+	uint32_t	sequence;
+	uint8_t		io;
+	uint8_t		pin;
+	uint8_t		value;
+	uint8_t		fill;
+} io_event_t;
+
+assert_size(io_event_t, 16);
+
+void	io_event_init(void);
+void	io_event_add_isr(uint64_t time_us, unsigned int io, uint32_t pin_status_mask, uint32_t pin_value_mask);
+void	io_event_add(uint64_t time_us, unsigned int io, uint32_t pin_status_mask, uint32_t pin_value_mask);
+void	io_event_periodic(void);
+void	io_event_send(void);
+
+app_action_t application_function_io_events(app_params_t *);
+
+#endif
@@ -5,6 +5,8 @@
 #include "dispatch.h"
 #include "eagle.h"
 #include "sys_time.h"
+#include "io_event.h"
+#include "gamma.h"
 
 #include <stdlib.h>
 #include <stdint.h>
@@ -14,6 +16,7 @@ enum
 {
 	io_gpio_pin_size = 16,
 	io_gpio_pwm_max_channels = 4,
+	io_gpio_frequency_ccount_span_max_us = 16000000, // ccount wraps after ~26 s at 160 MHz
 };
 
 typedef enum
@@ -102,6 +105,20 @@ typedef union
 assert_size(gpio_data_pin_t, 4);
 
 static gpio_data_pin_t gpio_data[io_gpio_pin_size];
+static unsigned int gpio_pwm1_value[io_gpio_pin_size]; // as written, before gamma
+
+typedef struct
+{
+	uint32_t	first;			// ccount of first rising edge in this gate
+	uint32_t	last;			// ccount of last rising edge in this gate
+	uint32_t	high;			// accumulated high time of complete periods
+	uint32_t	high_pending;	// high time of the period in progress
+	uint32_t	edges;			// rising edges in this gate
+	uint64_t	last_us;		// time of the last rising edge, ccount wraps after ~26 s
+} gpio_frequency_t;
+
+static uint32_t			gpio_frequency_pins;
+static gpio_frequency_t	gpio_frequency[io_gpio_pin_size];
 
 roflash static gpio_info_t gpio_info_table[io_gpio_pin_size] =
 {
@@ -729,15 +746,63 @@ attr_inline void pin_arm_counter(int pin, bool enable)
 	gpio_pin_intr_state_set(pin, enable ? GPIO_PIN_INTR_ANYEDGE : GPIO_PIN_INTR_DISABLE);
 }
 
+iram static void frequency_edges(uint32_t now, uint32_t pin_mask, uint32_t pin_value_mask)
+{
+	gpio_frequency_t *frequency;
+	unsigned int pin;
+
+	for(pin = 0; pin < io_gpio_pin_size; pin++)
+	{
+		if(!(pin_mask & (1 << pin)))
+			continue;
+
+		frequency = &gpio_frequency[pin];
+
+		if(pin_value_mask & (1 << pin))
+		{
+			if(frequency->edges == 0)
+				frequency->first = now;
+			else
+				frequency->high += frequency->high_pending;
+
+			frequency->last = now;
+			frequency->high_pending = 0;
+			frequency->edges++;
+		}
+		else
+			if(frequency->edges > 0)
+				frequency->high_pending = now - frequency->last;
+	}
+}
+
 iram static void pc_int_isr(void *arg)
 {
+	uint32_t now;
 	uint32_t pin_value_mask;
 	uint32_t pin_interrupt_status_mask;
 
+	now = ccount();
 	pin_value_mask = gpio_get_all();
 	stat_pc_counts++;
 	pin_interrupt_status_mask = gpio_reg_read(GPIO_STATUS_ADDRESS);
 	gpio_reg_write(GPIO_STATUS_W1TC_ADDRESS, pin_interrupt_status_mask);
+
+	// frequency measurement pins are handled completely here, don't flood the task queue with their edges
+
+	if(pin_interrupt_status_mask & gpio_frequency_pins)
+	{
+		frequency_edges(now, pin_interrupt_status_mask & gpio_frequency_pins, pin_value_mask);
+		pin_interrupt_status_mask &= ~gpio_frequency_pins;
+	}
+
+	// same for rotary encoder pins, they're decoded right here
+
+	pin_interrupt_status_mask &= ~io_renc_decode(io_id_gpio, pin_interrupt_status_mask, pin_value_mask);
+
+	if(!pin_interrupt_status_mask)
+		return;
+
+	io_event_add_isr(time_get_us(), io_id_gpio, pin_interrupt_status_mask & 0x0000ffff, pin_value_mask);
 	dispatch_post_task(task_prio_medium, task_pins_changed_gpio, pin_interrupt_status_mask, pin_value_mask & 0x0000ffff, 0);
 }
 
@@ -865,6 +930,12 @@ static io_error_t init_pin_mode(string_t *error_message, const struct io_info_en
 	pin_arm_counter(pin, false);
 	gpio_pin_data = &gpio_data[pin];
 
+	gpio_frequency_pins &= ~(1 << pin);
+	gpio_frequency[pin].edges = 0;
+	gpio_frequency[pin].high = 0;
+	gpio_frequency[pin].high_pending = 0;
+	gpio_frequency[pin].last_us = 0;
+
 	switch(pin_config->llmode)
 	{
 		case(io_pin_ll_input_digital):
@@ -873,7 +944,12 @@ static io_error_t init_pin_mode(string_t *error_message, const struct io_info_en
 			gpio_init_pin(pin, io_gpio_func_gpio, io_gpio_read, pin_config->static_flags & io_flag_static_pullup ? io_gpio_enable_pullup : io_gpio_disable_pullup, io_gpio_push_pull, io_gpio_gpio);
 
 			if(pin_config->llmode == io_pin_ll_counter)
+			{
+				if(pin_config->mode == io_pin_frequency)
+					gpio_frequency_pins |= 1 << pin;
+
 				pin_arm_counter(pin, true);
+			}
 
 			break;
 		}
@@ -889,6 +965,7 @@ static io_error_t init_pin_mode(string_t *error_message, const struct io_info_en
 		{
 			gpio_init_pin(pin, io_gpio_func_gpio, io_gpio_write, io_gpio_disable_pullup, io_gpio_push_pull, io_gpio_gpio);
 			gpio_pin_data->pwm.pwm_duty = pin_config->static_flags & io_flag_static_invert ? pwm1_period() - 1 : 0;
+			gpio_pwm1_value[pin] = 0;
 			gpio_set(pin, false);
 			pwm_go();
 
@@ -971,6 +1048,63 @@ static io_error_t init_pin_mode(string_t *error_message, const struct io_info_en
 	return(io_ok);
 }
 
+// span is in cpu cycles, from ccount when possible, otherwise from the edges' times in us
+
+bool io_gpio_frequency_sample(unsigned int pin, unsigned int *periods, uint64_t *span, uint32_t *high, uint64_t *idle_us)
+{
+	gpio_frequency_t *frequency;
+	uint64_t now_us, first_us;
+	uint32_t now;
+	unsigned int cpu_mhz;
+
+	if((pin >= io_gpio_pin_size) || !(gpio_frequency_pins & (1 << pin)))
+		return(false);
+
+	frequency = &gpio_frequency[pin];
+	cpu_mhz = system_get_cpu_freq();
+
+	ets_isr_mask(1 << ETS_GPIO_INUM);
+
+	now_us = time_get_us();
+	now = ccount();
+
+	*periods = (frequency->edges > 0) ? frequency->edges - 1 : 0;
+	*high = frequency->high;
+
+	// there has been a rising edge in this gate, which is less than a gate time (so less than a ccount wrap) ago
+
+	first_us = frequency->last_us;
+
+	if((frequency->edges > 1) || ((frequency->edges == 1) && (frequency->last_us == 0)))
+	{
+		if(first_us == 0)
+			first_us = now_us - ((now - frequency->first) / cpu_mhz);
+
+		frequency->last_us = now_us - ((now - frequency->last) / cpu_mhz);
+	}
+
+	if((frequency->last_us - first_us) < io_gpio_frequency_ccount_span_max_us)
+		*span = frequency->last - frequency->first;
+	else
+		*span = (frequency->last_us - first_us) * cpu_mhz;
+
+	*idle_us = (frequency->last_us > 0) ? now_us - frequency->last_us : ~0ULL;
+
+	// the next gate starts at the last rising edge, so there is no dead time between gates
+
+	if(frequency->edges > 0)
+	{
+		frequency->first = frequency->last;
+		frequency->edges = 1;
+	}
+
+	frequency->high = 0;
+
+	ets_isr_unmask(1 << ETS_GPIO_INUM);
+
+	return(true);
+}
+
 static io_error_t get_pin_info(string_t *dst, const struct io_info_entry_T *info, io_data_pin_entry_t *pin_data, const io_config_pin_entry_t *pin_config, int pin)
 {
 	gpio_data_pin_t *gpio_pin_data;
@@ -1153,6 +1287,14 @@ static io_error_t read_pin(string_t *error_message, const struct io_info_entry_T
 
 		case(io_pin_ll_output_pwm1):
 		{
+			// report the value as written, so fades continue from there
+
+			if(gamma_pwm_active())
+			{
+				*value = gpio_pwm1_value[pin];
+				break;
+			}
+
 			*value = gpio_pin_data->pwm.pwm_duty;
 
 			if(pin_config->static_flags & io_flag_static_invert)
@@ -1243,6 +1385,9 @@ static io_error_t write_pin(string_t *error_message, const struct io_info_entry_
 			if(value >= pwm1_period())
 				value = pwm1_period() - 1;
 
+			gpio_pwm1_value[pin] = value;
+			value = gamma_pwm(value, pwm1_period());
+
 			if(pin_config->static_flags & io_flag_static_invert)
 				value = pwm1_period() - 1 - value;
 
@@ -27,6 +27,7 @@ gpio_i2s_pin_t	io_gpio_get_i2s_from_pin(unsigned int pin);
 bool			io_gpio_pin_usable(unsigned int pin);
 bool			io_gpio_pwm1_width_set(unsigned int period, bool load, bool save);
 unsigned int	io_gpio_pwm1_width_get(void);
+bool			io_gpio_frequency_sample(unsigned int pin, unsigned int *periods, uint64_t *span, uint32_t *high, uint64_t *idle_us);
 
 // generic
 
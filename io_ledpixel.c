@@ -3,6 +3,8 @@
 #include "uart.h"
 #include "i2s.h"
 #include "io_gpio.h"
+#include "eagle.h"
+#include "gamma.h"
 
 #include <stdlib.h>
 #include <stdint.h>
@@ -78,11 +80,44 @@ static bool use_i2s_invert = false;
 
 static ledpixel_data_pin_t ledpixel_data_pin[max_pins_per_io];
 
+// In framebuffer mode (i2s only) the whole strip is kept in ram, the pins map onto
+// the first pixels. Each frame is encoded into one of two buffers that the i2s dma
+// sends from, so the next frame can be prepared while the previous is still being sent.
+
+enum
+{
+	ledpixel_fb_reset_words = 32, // > 300 us of idle after the last pixel to latch the frame
+};
+
+typedef struct
+{
+	unsigned int	pixels;
+	unsigned int	pixel_words;
+	unsigned int	frame_words;
+	unsigned int	grb:1;
+	unsigned int	extended:1;
+	unsigned int	active;			// buffer being sent (or sent last)
+	volatile bool	pending;		// the other buffer is ready and will be sent when the active one finishes
+	unsigned int	frames;
+	unsigned int	superseded;
+	uint32_t		*pixel;
+	uint32_t		*error[2];		// dither residue per channel, after the frame in the same buffer
+	uint32_t		*encoded[2];
+	slc_pointer_t	*descriptor[2];
+} ledpixel_fb_t;
+
+static ledpixel_fb_t fb;
+
 static unsigned int lookup_5_to_8(unsigned int entry)
 {
 	if(entry >= sizeof(lut_5_8))
 		return(0xff);
 
+	// the lut has a fixed curve built in, don't apply it twice
+
+	if(gamma_ledpixel_active())
+		return((entry << 3) | (entry >> 2));
+
 	return(lut_5_8[entry]);
 }
 
@@ -103,103 +138,372 @@ static void value_mask_to_rgb(unsigned int value, unsigned int *pinmask, unsigne
 	*rgb = (r << 16) | (g << 8) | (b << 0);
 }
 
-static void send_byte_uart(unsigned int byte)
+// Each colour byte expands into one 32 bit word. For i2s every input bit becomes
+// a nibble, 1000 for a zero and 1110 for a one, msb first, so the word can go into
+// the fifo (or dma buffer) as is. For uart (6 bits, 3.2 Mbaud) every two input bits
+// become one character, four per colour byte, first to send in the lowest byte. The
+// start and stop bits complete the pattern, from an idea by nodemcu coders:
+// https://github.com/nodemcu/nodemcu-firmware/blob/master/app/modules/ws2812.c
+
+roflash static const uint32_t ws2812_i2s_normal[256] =
 {
-	// from an idea by nodemcu coders: https://github.com/nodemcu/nodemcu-firmware/blob/master/app/modules/ws2812.c
+	0x88888888, 0x8888888e, 0x888888e8, 0x888888ee, 0x88888e88, 0x88888e8e, 0x88888ee8, 0x88888eee,	// 0x00
+	0x8888e888, 0x8888e88e, 0x8888e8e8, 0x8888e8ee, 0x8888ee88, 0x8888ee8e, 0x8888eee8, 0x8888eeee,	// 0x08
+	0x888e8888, 0x888e888e, 0x888e88e8, 0x888e88ee, 0x888e8e88, 0x888e8e8e, 0x888e8ee8, 0x888e8eee,	// 0x10
+	0x888ee888, 0x888ee88e, 0x888ee8e8, 0x888ee8ee, 0x888eee88, 0x888eee8e, 0x888eeee8, 0x888eeeee,	// 0x18
+	0x88e88888, 0x88e8888e, 0x88e888e8, 0x88e888ee, 0x88e88e88, 0x88e88e8e, 0x88e88ee8, 0x88e88eee,	// 0x20
+	0x88e8e888, 0x88e8e88e, 0x88e8e8e8, 0x88e8e8ee, 0x88e8ee88, 0x88e8ee8e, 0x88e8eee8, 0x88e8eeee,	// 0x28
+	0x88ee8888, 0x88ee888e, 0x88ee88e8, 0x88ee88ee, 0x88ee8e88, 0x88ee8e8e, 0x88ee8ee8, 0x88ee8eee,	// 0x30
+	0x88eee888, 0x88eee88e, 0x88eee8e8, 0x88eee8ee, 0x88eeee88, 0x88eeee8e, 0x88eeeee8, 0x88eeeeee,	// 0x38
+	0x8e888888, 0x8e88888e, 0x8e8888e8, 0x8e8888ee, 0x8e888e88, 0x8e888e8e, 0x8e888ee8, 0x8e888eee,	// 0x40
+	0x8e88e888, 0x8e88e88e, 0x8e88e8e8, 0x8e88e8ee, 0x8e88ee88, 0x8e88ee8e, 0x8e88eee8, 0x8e88eeee,	// 0x48
+	0x8e8e8888, 0x8e8e888e, 0x8e8e88e8, 0x8e8e88ee, 0x8e8e8e88, 0x8e8e8e8e, 0x8e8e8ee8, 0x8e8e8eee,	// 0x50
+	0x8e8ee888, 0x8e8ee88e, 0x8e8ee8e8, 0x8e8ee8ee, 0x8e8eee88, 0x8e8eee8e, 0x8e8eeee8, 0x8e8eeeee,	// 0x58
+	0x8ee88888, 0x8ee8888e, 0x8ee888e8, 0x8ee888ee, 0x8ee88e88, 0x8ee88e8e, 0x8ee88ee8, 0x8ee88eee,	// 0x60
+	0x8ee8e888, 0x8ee8e88e, 0x8ee8e8e8, 0x8ee8e8ee, 0x8ee8ee88, 0x8ee8ee8e, 0x8ee8eee8, 0x8ee8eeee,	// 0x68
+	0x8eee8888, 0x8eee888e, 0x8eee88e8, 0x8eee88ee, 0x8eee8e88, 0x8eee8e8e, 0x8eee8ee8, 0x8eee8eee,	// 0x70
+	0x8eeee888, 0x8eeee88e, 0x8eeee8e8, 0x8eeee8ee, 0x8eeeee88, 0x8eeeee8e, 0x8eeeeee8, 0x8eeeeeee,	// 0x78
+	0xe8888888, 0xe888888e, 0xe88888e8, 0xe88888ee, 0xe8888e88, 0xe8888e8e, 0xe8888ee8, 0xe8888eee,	// 0x80
+	0xe888e888, 0xe888e88e, 0xe888e8e8, 0xe888e8ee, 0xe888ee88, 0xe888ee8e, 0xe888eee8, 0xe888eeee,	// 0x88
+	0xe88e8888, 0xe88e888e, 0xe88e88e8, 0xe88e88ee, 0xe88e8e88, 0xe88e8e8e, 0xe88e8ee8, 0xe88e8eee,	// 0x90
+	0xe88ee888, 0xe88ee88e, 0xe88ee8e8, 0xe88ee8ee, 0xe88eee88, 0xe88eee8e, 0xe88eeee8, 0xe88eeeee,	// 0x98
+	0xe8e88888, 0xe8e8888e, 0xe8e888e8, 0xe8e888ee, 0xe8e88e88, 0xe8e88e8e, 0xe8e88ee8, 0xe8e88eee,	// 0xa0
+	0xe8e8e888, 0xe8e8e88e, 0xe8e8e8e8, 0xe8e8e8ee, 0xe8e8ee88, 0xe8e8ee8e, 0xe8e8eee8, 0xe8e8eeee,	// 0xa8
+	0xe8ee8888, 0xe8ee888e, 0xe8ee88e8, 0xe8ee88ee, 0xe8ee8e88, 0xe8ee8e8e, 0xe8ee8ee8, 0xe8ee8eee,	// 0xb0
+	0xe8eee888, 0xe8eee88e, 0xe8eee8e8, 0xe8eee8ee, 0xe8eeee88, 0xe8eeee8e, 0xe8eeeee8, 0xe8eeeeee,	// 0xb8
+	0xee888888, 0xee88888e, 0xee8888e8, 0xee8888ee, 0xee888e88, 0xee888e8e, 0xee888ee8, 0xee888eee,	// 0xc0
+	0xee88e888, 0xee88e88e, 0xee88e8e8, 0xee88e8ee, 0xee88ee88, 0xee88ee8e, 0xee88eee8, 0xee88eeee,	// 0xc8
+	0xee8e8888, 0xee8e888e, 0xee8e88e8, 0xee8e88ee, 0xee8e8e88, 0xee8e8e8e, 0xee8e8ee8, 0xee8e8eee,	// 0xd0
+	0xee8ee888, 0xee8ee88e, 0xee8ee8e8, 0xee8ee8ee, 0xee8eee88, 0xee8eee8e, 0xee8eeee8, 0xee8eeeee,	// 0xd8
+	0xeee88888, 0xeee8888e, 0xeee888e8, 0xeee888ee, 0xeee88e88, 0xeee88e8e, 0xeee88ee8, 0xeee88eee,	// 0xe0
+	0xeee8e888, 0xeee8e88e, 0xeee8e8e8, 0xeee8e8ee, 0xeee8ee88, 0xeee8ee8e, 0xeee8eee8, 0xeee8eeee,	// 0xe8
+	0xeeee8888, 0xeeee888e, 0xeeee88e8, 0xeeee88ee, 0xeeee8e88, 0xeeee8e8e, 0xeeee8ee8, 0xeeee8eee,	// 0xf0
+	0xeeeee888, 0xeeeee88e, 0xeeeee8e8, 0xeeeee8ee, 0xeeeeee88, 0xeeeeee8e, 0xeeeeeee8, 0xeeeeeeee,	// 0xf8
+};
 
-	static const unsigned int bit_pattern[4] =
-	{				//		mirror		add start/stop	negate
-		0b110111,	//	00	111-011		[0]111-011[1]	1000-1000
-		0b000111,	//	01	111-000		[0]111-000[1]	1000-1110
-		0b110100,	//	10	001-011		[0]001-011[1]	1110-1000
-		0b000100,	//	11	001-000		[0]001-000[1]	1110-1110
-	};
+roflash static const uint32_t ws2812_i2s_invert[256] =
+{
+	0x77777777, 0x77777771, 0x77777717, 0x77777711, 0x77777177, 0x77777171, 0x77777117, 0x77777111,	// 0x00
+	0x77771777, 0x77771771, 0x77771717, 0x77771711, 0x77771177, 0x77771171, 0x77771117, 0x77771111,	// 0x08
+	0x77717777, 0x77717771, 0x77717717, 0x77717711, 0x77717177, 0x77717171, 0x77717117, 0x77717111,	// 0x10
+	0x77711777, 0x77711771, 0x77711717, 0x77711711, 0x77711177, 0x77711171, 0x77711117, 0x77711111,	// 0x18
+	0x77177777, 0x77177771, 0x77177717, 0x77177711, 0x77177177, 0x77177171, 0x77177117, 0x77177111,	// 0x20
+	0x77171777, 0x77171771, 0x77171717, 0x77171711, 0x77171177, 0x77171171, 0x77171117, 0x77171111,	// 0x28
+	0x77117777, 0x77117771, 0x77117717, 0x77117711, 0x77117177, 0x77117171, 0x77117117, 0x77117111,	// 0x30
+	0x77111777, 0x77111771, 0x77111717, 0x77111711, 0x77111177, 0x77111171, 0x77111117, 0x77111111,	// 0x38
+	0x71777777, 0x71777771, 0x71777717, 0x71777711, 0x71777177, 0x71777171, 0x71777117, 0x71777111,	// 0x40
+	0x71771777, 0x71771771, 0x71771717, 0x71771711, 0x71771177, 0x71771171, 0x71771117, 0x71771111,	// 0x48
+	0x71717777, 0x71717771, 0x71717717, 0x71717711, 0x71717177, 0x71717171, 0x71717117, 0x71717111,	// 0x50
+	0x71711777, 0x71711771, 0x71711717, 0x71711711, 0x71711177, 0x71711171, 0x71711117, 0x71711111,	// 0x58
+	0x71177777, 0x71177771, 0x71177717, 0x71177711, 0x71177177, 0x71177171, 0x71177117, 0x71177111,	// 0x60
+	0x71171777, 0x71171771, 0x71171717, 0x71171711, 0x71171177, 0x71171171, 0x71171117, 0x71171111,	// 0x68
+	0x71117777, 0x71117771, 0x71117717, 0x71117711, 0x71117177, 0x71117171, 0x71117117, 0x71117111,	// 0x70
+	0x71111777, 0x71111771, 0x71111717, 0x71111711, 0x71111177, 0x71111171, 0x71111117, 0x71111111,	// 0x78
+	0x17777777, 0x17777771, 0x17777717, 0x17777711, 0x17777177, 0x17777171, 0x17777117, 0x17777111,	// 0x80
+	0x17771777, 0x17771771, 0x17771717, 0x17771711, 0x17771177, 0x17771171, 0x17771117, 0x17771111,	// 0x88
+	0x17717777, 0x17717771, 0x17717717, 0x17717711, 0x17717177, 0x17717171, 0x17717117, 0x17717111,	// 0x90
+	0x17711777, 0x17711771, 0x17711717, 0x17711711, 0x17711177, 0x17711171, 0x17711117, 0x17711111,	// 0x98
+	0x17177777, 0x17177771, 0x17177717, 0x17177711, 0x17177177, 0x17177171, 0x17177117, 0x17177111,	// 0xa0
+	0x17171777, 0x17171771, 0x17171717, 0x17171711, 0x17171177, 0x17171171, 0x17171117, 0x17171111,	// 0xa8
+	0x17117777, 0x17117771, 0x17117717, 0x17117711, 0x17117177, 0x17117171, 0x17117117, 0x17117111,	// 0xb0
+	0x17111777, 0x17111771, 0x17111717, 0x17111711, 0x17111177, 0x17111171, 0x17111117, 0x17111111,	// 0xb8
+	0x11777777, 0x11777771, 0x11777717, 0x11777711, 0x11777177, 0x11777171, 0x11777117, 0x11777111,	// 0xc0
+	0x11771777, 0x11771771, 0x11771717, 0x11771711, 0x11771177, 0x11771171, 0x11771117, 0x11771111,	// 0xc8
+	0x11717777, 0x11717771, 0x11717717, 0x11717711, 0x11717177, 0x11717171, 0x11717117, 0x11717111,	// 0xd0
+	0x11711777, 0x11711771, 0x11711717, 0x11711711, 0x11711177, 0x11711171, 0x11711117, 0x11711111,	// 0xd8
+	0x11177777, 0x11177771, 0x11177717, 0x11177711, 0x11177177, 0x11177171, 0x11177117, 0x11177111,	// 0xe0
+	0x11171777, 0x11171771, 0x11171717, 0x11171711, 0x11171177, 0x11171171, 0x11171117, 0x11171111,	// 0xe8
+	0x11117777, 0x11117771, 0x11117717, 0x11117711, 0x11117177, 0x11117171, 0x11117117, 0x11117111,	// 0xf0
+	0x11111777, 0x11111771, 0x11111717, 0x11111711, 0x11111177, 0x11111171, 0x11111117, 0x11111111,	// 0xf8
+};
 
-	unsigned int byte_bit_index;
-	unsigned int by_six = 0;
+roflash static const uint32_t ws2812_uart[256] =
+{
+	0x37373737, 0x07373737, 0x34373737, 0x04373737, 0x37073737, 0x07073737, 0x34073737, 0x04073737,	// 0x00
+	0x37343737, 0x07343737, 0x34343737, 0x04343737, 0x37043737, 0x07043737, 0x34043737, 0x04043737,	// 0x08
+	0x37370737, 0x07370737, 0x34370737, 0x04370737, 0x37070737, 0x07070737, 0x34070737, 0x04070737,	// 0x10
+	0x37340737, 0x07340737, 0x34340737, 0x04340737, 0x37040737, 0x07040737, 0x34040737, 0x04040737,	// 0x18
+	0x37373437, 0x07373437, 0x34373437, 0x04373437, 0x37073437, 0x07073437, 0x34073437, 0x04073437,	// 0x20
+	0x37343437, 0x07343437, 0x34343437, 0x04343437, 0x37043437, 0x07043437, 0x34043437, 0x04043437,	// 0x28
+	0x37370437, 0x07370437, 0x34370437, 0x04370437, 0x37070437, 0x07070437, 0x34070437, 0x04070437,	// 0x30
+	0x37340437, 0x07340437, 0x34340437, 0x04340437, 0x37040437, 0x07040437, 0x34040437, 0x04040437,	// 0x38
+	0x37373707, 0x07373707, 0x34373707, 0x04373707, 0x37073707, 0x07073707, 0x34073707, 0x04073707,	// 0x40
+	0x37343707, 0x07343707, 0x34343707, 0x04343707, 0x37043707, 0x07043707, 0x34043707, 0x04043707,	// 0x48
+	0x37370707, 0x07370707, 0x34370707, 0x04370707, 0x37070707, 0x07070707, 0x34070707, 0x04070707,	// 0x50
+	0x37340707, 0x07340707, 0x34340707, 0x04340707, 0x37040707, 0x07040707, 0x34040707, 0x04040707,	// 0x58
+	0x37373407, 0x07373407, 0x34373407, 0x04373407, 0x37073407, 0x07073407, 0x34073407, 0x04073407,	// 0x60
+	0x37343407, 0x07343407, 0x34343407, 0x04343407, 0x37043407, 0x07043407, 0x34043407, 0x04043407,	// 0x68
+	0x37370407, 0x07370407, 0x34370407, 0x04370407, 0x37070407, 0x07070407, 0x34070407, 0x04070407,	// 0x70
+	0x37340407, 0x07340407, 0x34340407, 0x04340407, 0x37040407, 0x07040407, 0x34040407, 0x04040407,	// 0x78
+	0x37373734, 0x07373734, 0x34373734, 0x04373734, 0x37073734, 0x07073734, 0x34073734, 0x04073734,	// 0x80
+	0x37343734, 0x07343734, 0x34343734, 0x04343734, 0x37043734, 0x07043734, 0x34043734, 0x04043734,	// 0x88
+	0x37370734, 0x07370734, 0x34370734, 0x04370734, 0x37070734, 0x07070734, 0x34070734, 0x04070734,	// 0x90
+	0x37340734, 0x07340734, 0x34340734, 0x04340734, 0x37040734, 0x07040734, 0x34040734, 0x04040734,	// 0x98
+	0x37373434, 0x07373434, 0x34373434, 0x04373434, 0x37073434, 0x07073434, 0x34073434, 0x04073434,	// 0xa0
+	0x37343434, 0x07343434, 0x34343434, 0x04343434, 0x37043434, 0x07043434, 0x34043434, 0x04043434,	// 0xa8
+	0x37370434, 0x07370434, 0x34370434, 0x04370434, 0x37070434, 0x07070434, 0x34070434, 0x04070434,	// 0xb0
+	0x37340434, 0x07340434, 0x34340434, 0x04340434, 0x37040434, 0x07040434, 0x34040434, 0x04040434,	// 0xb8
+	0x37373704, 0x07373704, 0x34373704, 0x04373704, 0x37073704, 0x07073704, 0x34073704, 0x04073704,	// 0xc0
+	0x37343704, 0x07343704, 0x34343704, 0x04343704, 0x37043704, 0x07043704, 0x34043704, 0x04043704,	// 0xc8
+	0x37370704, 0x07370704, 0x34370704, 0x04370704, 0x37070704, 0x07070704, 0x34070704, 0x04070704,	// 0xd0
+	0x37340704, 0x07340704, 0x34340704, 0x04340704, 0x37040704, 0x07040704, 0x34040704, 0x04040704,	// 0xd8
+	0x37373404, 0x07373404, 0x34373404, 0x04373404, 0x37073404, 0x07073404, 0x34073404, 0x04073404,	// 0xe0
+	0x37343404, 0x07343404, 0x34343404, 0x04343404, 0x37043404, 0x07043404, 0x34043404, 0x04043404,	// 0xe8
+	0x37370404, 0x07370404, 0x34370404, 0x04370404, 0x37070404, 0x07070404, 0x34070404, 0x04070404,	// 0xf0
+	0x37340404, 0x07340404, 0x34340404, 0x04340404, 0x37040404, 0x07040404, 0x34040404, 0x04040404,	// 0xf8
+};
 
-	for(byte_bit_index = 0; byte_bit_index < 4; byte_bit_index++)
-	{
-		by_six = bit_pattern[(byte & 0b11000000) >> 6];
-		byte <<= 2;
+static const uint32_t *i2s_table = ws2812_i2s_normal;
 
-		if(use_uart_0)
-			uart_send(0, by_six);
+// some ws2812's have four leds (including a white one) and need an extra byte to be sent for it
 
-		if(use_uart_1)
-			uart_send(1, by_six);
-	}
+attr_inline unsigned int encode_pixel(uint32_t *word, const uint32_t *table, unsigned int value, bool grb, bool extended)
+{
+	unsigned int r = (value & 0x00ff0000) >> 16;
+	unsigned int g = (value & 0x0000ff00) >>  8;
+
+	word[0] = table[grb ? g : r];
+	word[1] = table[grb ? r : g];
+	word[2] = table[(value & 0x000000ff) >> 0];
+
+	if(!extended)
+		return(3);
+
+	word[3] = table[(value & 0xff000000) >> 24];
+
+	return(4);
 }
 
-static void send_byte_i2s(unsigned int byte_value_in)
+// gamma per channel, when dithering the fraction is carried to the next frame in *error
+
+static unsigned int pixel_gamma(unsigned int value, uint32_t *error)
 {
-	static const unsigned int off_pattern_normal = 0b1000;
-	static const unsigned int on_pattern_normal = 0b1110;
-	static const unsigned int off_pattern_invert = 0b0111;
-	static const unsigned int on_pattern_invert = 0b0001;
-	uint8_t buffer[4];
-	unsigned int bit_in;
-	unsigned int byte_out;
-	unsigned int pattern;
+	unsigned int shift, level, result;
 
-	for(bit_in = 0, byte_out = 0; (bit_in < 8) && (byte_out < 4); bit_in++)
+	if(!gamma_ledpixel_active())
+		return(value);
+
+	for(shift = 0, result = 0; shift < 32; shift += 8)
 	{
-		pattern = (byte_value_in & (1 << (7 - bit_in))) ? (use_i2s_invert ? on_pattern_invert : on_pattern_normal) : (use_i2s_invert ? off_pattern_invert : off_pattern_normal);
+		level = gamma_ledpixel((value >> shift) & 0xff);
 
-		if(bit_in & 0x01) // after every second input bit the output nibble is full
+		if(error)
 		{
-			buffer[byte_out] <<= 4;
-			buffer[byte_out] |= pattern;
-			byte_out++;
+			level += (*error >> shift) & 0xff;
+			*error = (*error & ~(0xffUL << shift)) | ((level & 0xff) << shift);
 		}
 		else
-			buffer[byte_out] = pattern;
+			level += 0x80;
+
+		level >>= 8;
+
+		if(level > 0xff)
+			level = 0xff;
+
+		result |= level << shift;
+	}
+
+	return(result);
+}
+
+static void send_words_uart(unsigned int words, const uint32_t *word)
+{
+	unsigned int symbol;
+	uint32_t value;
+
+	for(; words > 0; words--, word++)
+	{
+		for(symbol = 0, value = *word; symbol < 4; symbol++, value >>= 8)
+		{
+			if(use_uart_0)
+				uart_send(0, value & 0xff);
+
+			if(use_uart_1)
+				uart_send(1, value & 0xff);
+		}
+	}
+}
+
+// the dither residue continues from the frame in the active buffer, which has actually been sent,
+// so a frame that is superseded before it's sent doesn't advance the residue
+
+static void fb_encode(unsigned int buffer)
+{
+	unsigned int pixel;
+	uint32_t *word, *error;
+	const uint32_t *previous_error;
+
+	bool dither = gamma_dither();
+
+	word = fb.encoded[buffer];
+	error = fb.error[buffer];
+	previous_error = fb.error[buffer ^ 1];
+
+	for(pixel = 0; pixel < fb.pixels; pixel++)
+	{
+		error[pixel] = previous_error[pixel];
+		word += encode_pixel(word, i2s_table, pixel_gamma(fb.pixel[pixel], dither ? &error[pixel] : (uint32_t *)0), fb.grb, fb.extended);
+	}
+
+	for(pixel = 0; pixel < ledpixel_fb_reset_words; pixel++)
+		*word++ = use_i2s_invert ? 0xffffffff : 0x00000000;
+}
+
+// called from the slc isr when a frame has been sent completely
+
+iram static bool fb_dma_done(void)
+{
+	if(!fb.pending)
+		return(false);
+
+	fb.pending = false;
+	fb.active ^= 1;
+	fb.frames++;
+
+	return(i2s_dma_start(fb.descriptor[fb.active]));
+}
+
+static bool fb_show(void)
+{
+	unsigned int next;
+
+	if(!fb.pixels)
+		return(false);
+
+	// a frame that is still waiting is replaced by this one
+
+	ets_isr_mask(1 << ETS_SLC_INUM);
+
+	if(fb.pending)
+	{
+		fb.pending = false;
+		fb.superseded++;
 	}
 
-										//	always send at least four bytes at once,
-										//	to prevent padding zero bytes from being
-	i2s_send(sizeof(buffer), buffer);	//	inserted as i2s uses a fifo of 32 bit words
+	next = fb.active ^ 1;
+
+	ets_isr_unmask(1 << ETS_SLC_INUM);
+
+	fb_encode(next);
+
+	ets_isr_mask(1 << ETS_SLC_INUM);
+
+	if(i2s_dma_busy())
+		fb.pending = true;
+	else
+	{
+		fb.active = next;
+		fb.frames++;
+		i2s_dma_start(fb.descriptor[next]);
+	}
+
+	ets_isr_unmask(1 << ETS_SLC_INUM);
+
+	return(true);
 }
 
-static void send_byte(unsigned int byte)
+static bool fb_init(unsigned int pixels, const io_config_pin_entry_t *pin_config)
 {
-	if(use_i2s)
-		send_byte_i2s(byte);
+	unsigned int buffer, descriptors;
+
+	fb.grb = !!(pin_config->static_flags & io_flag_static_grb);
+	fb.extended = !!(pin_config->static_flags & io_flag_static_extended);
+	fb.pixel_words = fb.extended ? 4 : 3;
+	fb.frame_words = (pixels * fb.pixel_words) + ledpixel_fb_reset_words;
+	fb.active = 0;
+	fb.pending = false;
+	fb.frames = 0;
+	fb.superseded = 0;
 
-	if(use_uart_0 || use_uart_1)
-		send_byte_uart(byte);
+	descriptors = i2s_dma_descriptors(fb.frame_words);
+
+	if(!(fb.pixel = calloc(pixels, sizeof(*fb.pixel))))
+		goto error;
+
+	for(buffer = 0; buffer < 2; buffer++)
+	{
+		if(!(fb.error[buffer] = calloc(pixels, sizeof(*fb.error[buffer]))))
+			goto error;
+
+		if(!(fb.encoded[buffer] = malloc(fb.frame_words * sizeof(*fb.encoded[buffer]))))
+			goto error;
+
+		if(!(fb.descriptor[buffer] = malloc(descriptors * sizeof(*fb.descriptor[buffer]))))
+			goto error;
+
+		i2s_dma_setup(fb.descriptor[buffer], fb.encoded[buffer], fb.frame_words);
+	}
+
+	if(!i2s_dma_init(fb_dma_done))
+		goto error;
+
+	fb.pixels = pixels;
+
+	return(true);
+
+error:
+	log("ledpixel: cannot allocate framebuffer for %u pixels\n", pixels);
+
+	for(buffer = 0; buffer < 2; buffer++)
+	{
+		free(fb.descriptor[buffer]);
+		free(fb.encoded[buffer]);
+		free(fb.error[buffer]);
+		fb.descriptor[buffer] = (slc_pointer_t *)0;
+		fb.encoded[buffer] = (uint32_t *)0;
+		fb.error[buffer] = (uint32_t *)0;
+	}
+
+	free(fb.pixel);
+	fb.pixel = (uint32_t *)0;
+	fb.pixels = 0;
+
+	return(false);
 }
 
 static void send_all(bool force)
 {
-	static const uint8_t zero_sample_normal[] = { 0, 0, 0, 0, 0, 0, 0, 0 };
-	static const uint8_t zero_sample_invert[] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
-	unsigned int pin, fill;
+	static const uint32_t zero_sample_normal[] = { 0x00000000, 0x00000000 };
+	static const uint32_t zero_sample_invert[] = { 0xffffffff, 0xffffffff };
+	uint32_t i2s_words[4], uart_words[4];
+	unsigned int pin, fill, pixel, words, value;
+	const ledpixel_data_pin_t *data_pin;
+
+	if(fb.pixels)
+	{
+		for(pin = 0, pixel = 0; (pin < max_pins_per_io) && (pixel < fb.pixels); pin++)
+		{
+			if(!force && !ledpixel_data_pin[pin].enabled)
+				break;
+
+			for(fill = ledpixel_data_pin[pin].fill8 ? 8 : 1; (fill > 0) && (pixel < fb.pixels); fill--)
+				fb.pixel[pixel++] = ledpixel_data_pin[pin].value;
+		}
+
+		fb_show();
+
+		if(!use_uart_0 && !use_uart_1)
+			return;
+	}
 
 	for(pin = 0; pin < max_pins_per_io; pin++)
 	{
-		if(!force && !ledpixel_data_pin[pin].enabled)
-			break;
+		data_pin = &ledpixel_data_pin[pin];
 
-		for(fill = ledpixel_data_pin[pin].fill8 ? 8 : 1; fill > 0; fill--)
-		{
-			if(ledpixel_data_pin[pin].grb)
-			{
-				send_byte((ledpixel_data_pin[pin].value & 0x0000ff00) >>   8);
-				send_byte((ledpixel_data_pin[pin].value & 0x00ff0000) >>  16);
-			}
-			else
-			{
-				send_byte((ledpixel_data_pin[pin].value & 0x00ff0000) >>  16);
-				send_byte((ledpixel_data_pin[pin].value & 0x0000ff00) >>   8);
-			}
+		if(!force && !data_pin->enabled)
+			break;
 
-			send_byte((ledpixel_data_pin[pin].value & 0x000000ff) >>  0);
+		value = pixel_gamma(data_pin->value, (uint32_t *)0);
+		words = encode_pixel(i2s_words, i2s_table, value, data_pin->grb, data_pin->extended);
+		encode_pixel(uart_words, ws2812_uart, value, data_pin->grb, data_pin->extended);
 
-			// some ws2812's have four leds (including a white one) and need an extra byte to be sent for it
+		for(fill = data_pin->fill8 ? 8 : 1; fill > 0; fill--)
+		{
+			if(use_i2s && !fb.pixels)
+				i2s_send_words(words, i2s_words);
 
-			if(ledpixel_data_pin[pin].extended)
-				send_byte((ledpixel_data_pin[pin].value & 0xff000000) >>  24);
+			if(use_uart_0 || use_uart_1)
+				send_words_uart(words, uart_words);
 		}
 
 		if(use_uart_0)
@@ -209,12 +513,12 @@ static void send_all(bool force)
 			uart_flush(1);
 	}
 
-	if(use_i2s)
+	if(use_i2s && !fb.pixels)
 	{
 		if(use_i2s_invert)
-			i2s_send(sizeof(zero_sample_invert), zero_sample_invert); // the last "sample" (4 bytes) get repeated until the transmitter is stopped
+			i2s_send_words(2, zero_sample_invert); // the last "sample" (4 bytes) get repeated until the transmitter is stopped
 		else
-			i2s_send(sizeof(zero_sample_normal), zero_sample_normal); // the last "sample" (4 bytes) get repeated until the transmitter is stopped
+			i2s_send_words(2, zero_sample_normal); // the last "sample" (4 bytes) get repeated until the transmitter is stopped
 
 		i2s_flush();
 	}
@@ -253,7 +557,15 @@ bool io_ledpixel_pre_init(unsigned int io, unsigned int pin)
 			pin_config = &io_config[io][pin];
 
 			if(pin_config->static_flags & io_flag_static_invert)
+			{
 				use_i2s_invert = true;
+				i2s_table = ws2812_i2s_invert;
+			}
+
+			fb.pixels = pin_config->speed; // allocated in init
+
+			if(fb.pixels > ledpixel_fb_pixels_max)
+				fb.pixels = ledpixel_fb_pixels_max;
 
 			break;
 		}
@@ -303,6 +615,9 @@ static io_error_t init(const struct io_info_entry_T *info)
 	if(use_i2s && !i2s_init())
 		return(io_error);
 
+	if(use_i2s && (fb.pixels > 0))
+		fb_init(fb.pixels, &io_config[info->id][0]);
+
 	return(io_ok);
 }
 
@@ -372,6 +687,78 @@ io_error_t io_ledpixel_pinmask(unsigned int mask)
 	return(io_ok);
 }
 
+unsigned int io_ledpixel_fb_size(void)
+{
+	return(fb.pixels);
+}
+
+bool io_ledpixel_fb_set(unsigned int pixel, unsigned int value)
+{
+	if(pixel >= fb.pixels)
+		return(false);
+
+	fb.pixel[pixel] = value;
+
+	return(true);
+}
+
+bool io_ledpixel_fb_get(unsigned int pixel, unsigned int *value)
+{
+	if(pixel >= fb.pixels)
+		return(false);
+
+	*value = fb.pixel[pixel];
+
+	return(true);
+}
+
+bool io_ledpixel_fb_show(void)
+{
+	return(fb_show());
+}
+
+app_action_t application_function_ledpixel_fb(app_params_t *parameters)
+{
+	string_new(, command, 16);
+	unsigned int pixel, value, count;
+
+	if((parse_string(1, parameters->src, &command, ' ') == parse_ok) && !string_match_cstr(&command, "status"))
+	{
+		if(!fb.pixels)
+		{
+			string_append(parameters->dst, "> ledpixel framebuffer not active, use io-mode <io> <pin> ledpixel <pixels> on the i2s pin\n");
+			return(app_action_error);
+		}
+
+		if(string_match_cstr(&command, "set"))
+		{
+			if((parse_uint(2, parameters->src, &pixel, 0, ' ') != parse_ok) || (parse_uint(3, parameters->src, &value, 0, ' ') != parse_ok))
+			{
+				string_append(parameters->dst, "> usage: ledpixel-fb set <pixel> <value> [<count>]\n");
+				return(app_action_error);
+			}
+
+			if(parse_uint(4, parameters->src, &count, 0, ' ') != parse_ok)
+				count = 1;
+
+			for(; (count > 0) && (pixel < fb.pixels); count--, pixel++)
+				fb.pixel[pixel] = value;
+		}
+		else if(string_match_cstr(&command, "show"))
+			fb_show();
+		else
+		{
+			string_append(parameters->dst, "> usage: ledpixel-fb [status | set <pixel> <value> [<count>] | show]\n");
+			return(app_action_error);
+		}
+	}
+
+	string_format(parameters->dst, "> ledpixel framebuffer: pixels: %u, words per frame: %u, frames: %u, superseded: %u, busy: %s\n",
+			fb.pixels, fb.frame_words, fb.frames, fb.superseded, i2s_dma_busy() ? "yes" : "no");
+
+	return(app_action_normal);
+}
+
 roflash const io_info_entry_t io_info_entry_ledpixel =
 {
 	io_id_ledpixel, /* = 6 */
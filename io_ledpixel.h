@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <io.h>
+#include "dispatch.h"
 
 typedef enum
 {
@@ -13,10 +14,21 @@ typedef enum
 	ledpixel_i2s
 } io_ledpixel_mode_t;
 
+enum
+{
+	ledpixel_fb_pixels_max = 1024,
+};
+
 extern const io_info_entry_t io_info_entry_ledpixel;
 
 io_error_t			io_ledpixel_pinmask(unsigned int mask);
 io_ledpixel_mode_t	io_ledpixel_mode(unsigned int io, unsigned int pin);
 bool				io_ledpixel_pre_init(unsigned int io, unsigned int pin);
+unsigned int		io_ledpixel_fb_size(void);
+bool				io_ledpixel_fb_set(unsigned int pixel, unsigned int value);
+bool				io_ledpixel_fb_get(unsigned int pixel, unsigned int *value);
+bool				io_ledpixel_fb_show(void);
+
+app_action_t application_function_ledpixel_fb(app_params_t *);
 
 #endif
@@ -4,6 +4,8 @@
 #include "dispatch.h"
 #include "util.h"
 #include "config.h"
+#include "sys_time.h"
+#include "io_event.h"
 
 #include <stdlib.h>
 #include <stdint.h>
@@ -47,6 +49,22 @@ static mcp_data_t mcp_data;
 
 assert_size(mcp_data, (4 * io_mcp_instance_size) + 1);
 
+enum
+{
+	mcp_registers = 0x16,
+};
+
+// write-through shadow of the (linear mode) registers, only GPIO, INTF and INTCAP need to come from the chip,
+// the shadow is dropped on init and on any bus error
+
+typedef struct
+{
+	uint32_t	valid;
+	uint8_t		value[mcp_registers];
+} mcp_shadow_t;
+
+static mcp_shadow_t mcp_shadow[io_mcp_instance_size];
+
 attr_inline int IODIR(int s)		{ return(0x00 + s);	}
 attr_inline int IPOL(int s)			{ return(0x02 + s);	}
 attr_inline int GPINTEN(int s)		{ return(0x04 + s);	}
@@ -60,7 +78,7 @@ attr_inline int INTCAP(int s)		{ return(0x10 + s);	}
 attr_inline int GPIO(int s)			{ return(0x12 + s);	}
 attr_inline int OLAT(int s)			{ return(0x14 + s);	}
 
-static io_error_t read_register(string_t *error_message, const io_info_entry_t *info, unsigned int reg, unsigned int *value)
+static io_error_t read_register_bus(string_t *error_message, const io_info_entry_t *info, unsigned int reg, unsigned int *value)
 {
 	if(info->address)
 	{
@@ -157,7 +175,7 @@ static io_error_t read_register_4(string_t *error_message, const io_info_entry_t
 	return(io_ok);
 }
 
-static io_error_t write_register(string_t *error_message, const io_info_entry_t *info, unsigned int reg, unsigned int value)
+static io_error_t write_register_bus(string_t *error_message, const io_info_entry_t *info, unsigned int reg, unsigned int value)
 {
 	if(info->address)
 	{
@@ -195,7 +213,7 @@ static io_error_t write_register(string_t *error_message, const io_info_entry_t
 	return(io_ok);
 }
 
-static io_error_t write_register_2(string_t *error_message, const io_info_entry_t *info, unsigned int reg, unsigned int value_0, unsigned int value_1)
+static io_error_t write_register_2_bus(string_t *error_message, const io_info_entry_t *info, unsigned int reg, unsigned int value_0, unsigned int value_1)
 {
 	if(info->address)
 	{
@@ -236,18 +254,93 @@ static io_error_t write_register_2(string_t *error_message, const io_info_entry_
 	return(io_ok);
 }
 
+static void shadow_invalidate(const io_info_entry_t *info)
+{
+	mcp_shadow[info->instance].valid = 0;
+}
+
+attr_inline bool shadow_cacheable(unsigned int reg)
+{
+	return((reg < mcp_registers) && ((reg < (unsigned int)INTF(0)) || (reg >= (unsigned int)OLAT(0))));
+}
+
+static void shadow_store(const io_info_entry_t *info, unsigned int reg, unsigned int value)
+{
+	mcp_shadow_t *shadow = &mcp_shadow[info->instance];
+
+	if((reg == (unsigned int)GPIO(0)) || (reg == (unsigned int)GPIO(1))) // writing to GPIO writes to OLAT
+		reg = OLAT(reg - GPIO(0));
+
+	if(!shadow_cacheable(reg))
+		return;
+
+	shadow->value[reg] = value;
+	shadow->valid |= 1 << reg;
+}
+
+static io_error_t read_register(string_t *error_message, const io_info_entry_t *info, unsigned int reg, unsigned int *value)
+{
+	mcp_shadow_t *shadow = &mcp_shadow[info->instance];
+
+	if(shadow_cacheable(reg) && (shadow->valid & (1 << reg)))
+	{
+		*value = shadow->value[reg];
+		return(io_ok);
+	}
+
+	if(read_register_bus(error_message, info, reg, value) != io_ok)
+	{
+		shadow_invalidate(info);
+		return(io_error);
+	}
+
+	shadow_store(info, reg, *value);
+
+	return(io_ok);
+}
+
+static io_error_t write_register(string_t *error_message, const io_info_entry_t *info, unsigned int reg, unsigned int value)
+{
+	if(write_register_bus(error_message, info, reg, value) != io_ok)
+	{
+		shadow_invalidate(info);
+		return(io_error);
+	}
+
+	shadow_store(info, reg, value);
+
+	return(io_ok);
+}
+
+static io_error_t write_register_2(string_t *error_message, const io_info_entry_t *info, unsigned int reg, unsigned int value_0, unsigned int value_1)
+{
+	if(write_register_2_bus(error_message, info, reg, value_0, value_1) != io_ok)
+	{
+		shadow_invalidate(info);
+		return(io_error);
+	}
+
+	shadow_store(info, reg + 0, value_0);
+	shadow_store(info, reg + 1, value_1);
+
+	return(io_ok);
+}
+
 static io_error_t clear_set_register(string_t *error_message, const io_info_entry_t *info, unsigned int reg, unsigned int clearmask, unsigned int setmask)
 {
 	io_error_t error;
-	unsigned int value;
+	unsigned int value, new_value;
 
 	if((error = read_register(error_message, info, reg, &value)) != io_ok)
 		return(error);
 
-	value &= ~clearmask;
-	value |= setmask;
+	new_value = value & ~clearmask;
+	new_value |= setmask;
 
-	if((error = write_register(error_message, info, reg, value)) != io_ok)
+	if(shadow_cacheable(reg) && (new_value == value))
+		return(io_ok);
+
+	if((error = write_register(error_message, info, reg, new_value)) != io_ok)
 		return(error);
 
 	return(io_ok);
@@ -273,9 +366,11 @@ static io_error_t init(const io_info_entry_t *info)
 	// if config was in linear mode already, GPINTEN(1) will be written instead of IOCON
 	// fix this after the config is in lineair mode
 
-	if(write_register((string_t *)0, info, IOCON_banked(0), iocon_value) != io_ok)
+	if(write_register_bus((string_t *)0, info, IOCON_banked(0), iocon_value) != io_ok)
 		return(io_error);
 
+	shadow_invalidate(info);
+
 	// config should be in linear mode now
 
 	if(write_register((string_t *)0, info, IOCON_linear(0), iocon_value) != io_ok)
@@ -311,7 +406,7 @@ static io_error_t init_i2c(const io_info_entry_t *info)
 
 	// TEST i2c bus and device
 
-	if(read_register((string_t *)0, info, IOCON_banked(0), &value) != io_ok)
+	if(read_register_bus((string_t *)0, info, IOCON_banked(0), &value) != io_ok)
 		return(io_error);
 
 	return(init(info));
@@ -393,8 +488,11 @@ static void pin_change_common_handler(const io_info_entry_t *info, bool interrup
 		return;
 
 	if((intf[0] != 0) || (intf[1] != 0))
+	{
+		io_event_add(time_get_us(), info->id, (intf[1] << 8) | (intf[0] << 0), (intcap[1] << 8) | (intcap[0] << 0));
 		dispatch_post_task(task_prio_low, task_pins_changed_mcp,
 				(intf[1] << 8) | (intf[0] << 0),  (intcap[1] << 8) | (intcap[0] << 0), info->id);
+	}
 	else
 		if(interrupt)
 			log("mcp[%u]: pin-change-common-handler called from interrupt with no interrupt pending\n", info->address);
@@ -422,6 +520,8 @@ void io_mcp_pins_changed(uint32_t pin_status_mask, uint16_t pin_value_mask, uint
 		return;
 	}
 
+	pin_status_mask &= ~io_renc_decode(io, pin_status_mask, pin_value_mask);
+
 	for(pin = 0; pin < io_mcp_pin_size; pin++)
 	{
 		if(!(pin_status_mask & (1 << pin)))
@@ -560,7 +660,7 @@ static io_error_t get_pin_info(string_t *dst, const io_info_entry_t *info, io_da
 
 			io = tv & (1 << bankpin);
 
-			if(read_register(dst, info, OLAT(bank), &tv) != io_ok)
+			if(read_register_bus(dst, info, OLAT(bank), &tv) != io_ok)
 				return(io_error);
 
 			olat = tv & (1 << bankpin);
@@ -659,8 +759,8 @@ static io_error_t set_mask(string_t *error_message, const io_info_entry_t *info,
 {
 	mcp_data.instance[info->instance].pin_output_cache[0] &= ~((mask & 0x00ff) >> 0);
 	mcp_data.instance[info->instance].pin_output_cache[1] &= ~((mask & 0xff00) >> 8);
-	mcp_data.instance[info->instance].pin_output_cache[0] |= (pins & 0x00ff) >> 0;
-	mcp_data.instance[info->instance].pin_output_cache[1] |= (pins & 0xff00) >> 8;
+	mcp_data.instance[info->instance].pin_output_cache[0] |= (pins & mask & 0x00ff) >> 0;
+	mcp_data.instance[info->instance].pin_output_cache[1] |= (pins & mask & 0xff00) >> 8;
 
 	if(write_register_2(error_message, info, GPIO(0), mcp_data.instance[info->instance].pin_output_cache[0], mcp_data.instance[info->instance].pin_output_cache[1]) != io_ok)
 		return(io_error);
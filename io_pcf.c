@@ -1,6 +1,8 @@
 #include "io_pcf.h"
 #include "i2c.h"
 #include "util.h"
+#include "sys_time.h"
+#include "io_event.h"
 
 #include <stdlib.h>
 
@@ -48,6 +50,8 @@ void io_pcf_pins_changed(uint32_t pin_status_mask, uint16_t pin_value_mask, uint
 		return;
 	}
 
+	pin_status_mask &= ~io_renc_decode(io, pin_status_mask, pin_value_mask);
+
 	for(pin = 0; pin < io_pcf_pin_size; pin++)
 	{
 		if(!(pin_status_mask & (1 << pin)))
@@ -110,7 +114,10 @@ static void pin_change_common_handler(const io_info_entry_t *info, bool interrup
 	*current = i2c_data[0] & pcf_data.instance[info->instance].counters;
 
 	if(*current != *previous)
+	{
+		io_event_add(time_get_us(), info->id, *current ^ *previous, *current);
 		dispatch_post_task(task_prio_low, task_pins_changed_pcf, *current ^ *previous, *current, info->id);
+	}
 	else
 		if(interrupt)
 			log("io_pcf[%u]: pin-change-common-handler called from interrupt with no interrupt pending\n", info->address);
@@ -252,7 +259,8 @@ static io_error_t set_mask(string_t *error_message, const struct io_info_entry_T
 {
 	i2c_error_t error;
 
-	pcf_data.instance[info->instance].pin_output_cache = pins & 0x000000ff;
+	pcf_data.instance[info->instance].pin_output_cache &= ~(mask & 0x000000ff);
+	pcf_data.instance[info->instance].pin_output_cache |= pins & mask & 0x000000ff;
 
 	if((error = i2c_send1(info->address, pcf_data.instance[info->instance].pin_output_cache)) != i2c_error_ok)
 	{
@@ -0,0 +1,419 @@
+#include "attribute.h"
+#include "ledpixel_effect.h"
+#include "io_ledpixel.h"
+#include "config.h"
+#include "sys_time.h"
+#include "gamma.h"
+
+// Effects are rendered into the ledpixel framebuffer, one frame every
+// ledpixel_effect_frame_ms. The fast timer counts down the frame time and posts
+// the render task, so rendering never runs from the timer itself. All math is
+// integer, the position within the effect's period is kept as 16 bit fraction.
+// The effect is stored in config as its command line, e.g.
+//		rainbow 5000 128
+// and restarted at boot.
+
+typedef enum
+{
+	effect_off,
+	effect_fade,
+	effect_chase,
+	effect_rainbow,
+	effect_twinkle,
+	effect_gradient,
+	effect_palette,
+	effect_size,
+	effect_error = effect_size,
+} effect_type_t;
+
+typedef struct
+{
+	effect_type_t	type;
+	unsigned int	period_ms;
+	unsigned int	parameter;
+	unsigned int	colours;
+	uint32_t		colour[ledpixel_effect_colours_max];
+	uint32_t		start_ms;
+	unsigned int	tick_ms;
+	uint32_t		random;
+	bool			render_posted;
+	unsigned int	frames;
+} effect_t;
+
+static effect_t effect;
+
+typedef struct
+{
+	const char		name[12];
+	effect_type_t	type;
+} effect_name_t;
+
+assert_size(effect_name_t, 16);
+
+roflash static const effect_name_t effect_names[effect_size] =
+{
+	{ "off",		effect_off		},
+	{ "fade",		effect_fade		},
+	{ "chase",		effect_chase	},
+	{ "rainbow",	effect_rainbow	},
+	{ "twinkle",	effect_twinkle	},
+	{ "gradient",	effect_gradient	},
+	{ "palette",	effect_palette	},
+};
+
+static effect_type_t effect_from_string(const string_t *src)
+{
+	unsigned int ix;
+	const effect_name_t *entry;
+
+	for(ix = 0; ix < effect_size; ix++)
+	{
+		entry = &effect_names[ix];
+
+		if(string_match_cstr_flash(src, entry->name))
+			return(entry->type);
+	}
+
+	return(effect_error);
+}
+
+static uint32_t random_next(void)
+{
+	// xorshift32, good enough for sparkles
+
+	effect.random ^= effect.random << 13;
+	effect.random ^= effect.random >> 17;
+	effect.random ^= effect.random << 5;
+
+	return(effect.random);
+}
+
+// per channel (w, r, g, b) from a to b, ratio 0 (a) - 256 (b)
+
+static uint32_t blend(uint32_t a, uint32_t b, unsigned int ratio)
+{
+	unsigned int shift;
+	int from, to;
+	uint32_t result;
+
+	for(shift = 0, result = 0; shift < 32; shift += 8)
+	{
+		from = (a >> shift) & 0xff;
+		to = (b >> shift) & 0xff;
+		result |= (uint32_t)((from + (((to - from) * (int)ratio) >> 8)) & 0xff) << shift;
+	}
+
+	return(result);
+}
+
+// colour wheel, hue 0 - 255, level 0 - 255
+
+static uint32_t wheel(unsigned int hue, unsigned int level)
+{
+	unsigned int offset, up, down;
+
+	hue &= 0xff;
+	offset = (hue % 85) * 3;
+	up = (offset * level) >> 8;
+	down = ((255 - offset) * level) >> 8;
+
+	if(hue < 85)
+		return((down << 16) | (up << 8));
+
+	if(hue < 170)
+		return((up << 0) | (down << 8));
+
+	return((up << 16) | (down << 0));
+}
+
+// position 0 - 65535 along the configured colours
+
+static uint32_t palette_at(unsigned int position, bool wrap)
+{
+	unsigned int segments, scaled, index;
+
+	segments = wrap ? effect.colours : effect.colours - 1;
+
+	if(segments == 0)
+		return(effect.colour[0]);
+
+	scaled = (position & 0xffff) * segments;
+	index = scaled >> 16;
+
+	return(blend(effect.colour[index], effect.colour[(index + 1) % effect.colours], (scaled & 0xffff) >> 8));
+}
+
+// <effect> [<period ms> [<parameter> [<colour> ...]]]
+
+static bool effect_parse(const string_t *src, int index, effect_t *dst)
+{
+	string_new(, token, 16);
+	unsigned int value;
+
+	if(parse_string(index++, src, &token, ' ') != parse_ok)
+		return(false);
+
+	if((dst->type = effect_from_string(&token)) == effect_error)
+		return(false);
+
+	if(parse_uint(index++, src, &dst->period_ms, 0, ' ') != parse_ok)
+		dst->period_ms = 2000;
+
+	if(dst->period_ms > ledpixel_effect_period_max)
+		return(false);
+
+	if(parse_uint(index++, src, &dst->parameter, 0, ' ') != parse_ok)
+		dst->parameter = 0;
+
+	for(dst->colours = 0; dst->colours < ledpixel_effect_colours_max; dst->colours++)
+	{
+		if(parse_uint(index++, src, &value, 0, ' ') != parse_ok)
+			break;
+
+		dst->colour[dst->colours] = value;
+	}
+
+	if(dst->colours == 0)
+		dst->colour[dst->colours++] = 0x00ffffff;
+
+	if(dst->colours == 1)
+		dst->colour[dst->colours++] = 0x00000000;
+
+	return(true);
+}
+
+static void effect_start(const effect_t *new_effect)
+{
+	effect.type = new_effect->type;
+	effect.period_ms = new_effect->period_ms;
+	effect.parameter = new_effect->parameter;
+	effect.colours = new_effect->colours;
+	memcpy(effect.colour, new_effect->colour, sizeof(effect.colour));
+	effect.start_ms = (uint32_t)(time_get_us() / 1000);
+	effect.tick_ms = ledpixel_effect_frame_ms;
+	effect.frames = 0;
+
+	if(!effect.random)
+		effect.random = effect.start_ms | 1;
+}
+
+void ledpixel_effect_init(void)
+{
+	string_new(, text, 64);
+	effect_t new_effect;
+
+	effect.type = effect_off;
+	effect.render_posted = false;
+
+	if(!config_get_string("ledpixel.effect", &text, -1, -1))
+		return;
+
+	if(!effect_parse(&text, 0, &new_effect))
+	{
+		log("ledpixel effect: config invalid\n");
+		return;
+	}
+
+	effect_start(&new_effect);
+}
+
+void ledpixel_effect_periodic(unsigned int rate_ms)
+{
+	// dithering needs the frame to be sent continuously, even when it doesn't change
+
+	if(((effect.type == effect_off) && !(gamma_dither() && io_ledpixel_fb_size())) || effect.render_posted)
+		return;
+
+	if(effect.tick_ms > rate_ms)
+	{
+		effect.tick_ms -= rate_ms;
+		return;
+	}
+
+	effect.tick_ms = ledpixel_effect_frame_ms;
+	effect.render_posted = true;
+	dispatch_post_task(task_prio_low, task_ledpixel_effect, 0, 0, 0);
+}
+
+void ledpixel_effect_render(void)
+{
+	unsigned int pixels, pixel, phase, ratio, head, length, level, decay;
+	unsigned int value, previous;
+
+	effect.render_posted = false;
+
+	if(!(pixels = io_ledpixel_fb_size()))
+		return;
+
+	if(effect.type == effect_off)
+	{
+		if(gamma_dither())
+			io_ledpixel_fb_show();
+
+		return;
+	}
+
+	if(effect.period_ms > 0)
+		phase = ((((uint32_t)(time_get_us() / 1000) - effect.start_ms) % effect.period_ms) << 16) / effect.period_ms;
+	else
+		phase = 0;
+
+	switch(effect.type)
+	{
+		case(effect_fade):
+		{
+			ratio = (phase < 0x8000) ? (phase >> 7) : ((0xffff - phase) >> 7);
+			value = blend(effect.colour[0], effect.colour[1], ratio);
+
+			for(pixel = 0; pixel < pixels; pixel++)
+				io_ledpixel_fb_set(pixel, value);
+
+			break;
+		}
+
+		case(effect_chase):
+		{
+			length = effect.parameter ? effect.parameter : 1;
+			head = (phase * pixels) >> 16;
+
+			for(pixel = 0; pixel < pixels; pixel++)
+				io_ledpixel_fb_set(pixel, (((head + pixels - pixel) % pixels) < length) ? effect.colour[0] : effect.colour[1]);
+
+			break;
+		}
+
+		case(effect_rainbow):
+		{
+			level = (effect.parameter && (effect.parameter < 256)) ? effect.parameter : 255;
+
+			for(pixel = 0; pixel < pixels; pixel++)
+				io_ledpixel_fb_set(pixel, wheel(((pixel << 8) / pixels) + (phase >> 8), level));
+
+			break;
+		}
+
+		case(effect_twinkle):
+		{
+			// lit pixels fade to the background over the period, parameter is new sparkles per 1000 pixels per frame
+
+			decay = effect.period_ms ? (ledpixel_effect_frame_ms * 256) / effect.period_ms : 256;
+
+			if(decay < 1)
+				decay = 1;
+
+			if(decay > 256)
+				decay = 256;
+
+			for(pixel = 0; pixel < pixels; pixel++)
+			{
+				if((random_next() % 1000) < effect.parameter)
+					value = effect.colour[0];
+				else
+				{
+					if(!io_ledpixel_fb_get(pixel, &previous))
+						previous = effect.colour[1];
+
+					// at small differences the step rounds to zero, finish the fade then
+
+					if((value = blend(previous, effect.colour[1], decay)) == previous)
+						value = effect.colour[1];
+				}
+
+				io_ledpixel_fb_set(pixel, value);
+			}
+
+			break;
+		}
+
+		case(effect_gradient):
+		{
+			for(pixel = 0; pixel < pixels; pixel++)
+				io_ledpixel_fb_set(pixel, palette_at((pixels > 1) ? (pixel * 0xffff) / (pixels - 1) : 0, false));
+
+			break;
+		}
+
+		case(effect_palette):
+		{
+			for(pixel = 0; pixel < pixels; pixel++)
+				io_ledpixel_fb_set(pixel, palette_at(((pixel << 16) / pixels) + phase, true));
+
+			break;
+		}
+
+		default:
+		{
+			return;
+		}
+	}
+
+	io_ledpixel_fb_show();
+	effect.frames++;
+}
+
+app_action_t application_function_ledpixel_effect(app_params_t *parameters)
+{
+	string_new(, text, 64);
+	effect_t new_effect;
+	unsigned int ix;
+	int offset;
+
+	if((offset = string_sep(parameters->src, 0, 1, ' ')) > 0)
+	{
+		string_splice(&text, 0, parameters->src, offset, -1);
+		string_trim_nl(&text);
+	}
+
+	if(!string_empty(&text))
+	{
+		if(!effect_parse(&text, 0, &new_effect))
+		{
+			string_append(parameters->dst, "> usage: ledpixel-effect [off | <effect> [<period ms> [<parameter> [<colour> ...]]]]\n");
+			string_append(parameters->dst, ">   effects: fade, chase (parameter: length), rainbow (parameter: level), twinkle (parameter: per mille),\n");
+			string_format(parameters->dst, ">   gradient, palette; period up to %u ms, up to %u colours as 0xwwrrggbb\n",
+					ledpixel_effect_period_max, ledpixel_effect_colours_max);
+			return(app_action_error);
+		}
+
+		if((new_effect.type != effect_off) && !io_ledpixel_fb_size())
+		{
+			string_append(parameters->dst, "> ledpixel framebuffer not active\n");
+			return(app_action_error);
+		}
+
+		if(!config_open_write())
+		{
+			string_append(parameters->dst, "> cannot set config (open)\n");
+			return(app_action_error);
+		}
+
+		config_delete("ledpixel.effect", false, -1, -1);
+
+		if((new_effect.type != effect_off) && !config_set_string("ledpixel.effect", string_to_cstr(&text), -1, -1))
+		{
+			config_abort_write();
+			string_append(parameters->dst, "> cannot set config\n");
+			return(app_action_error);
+		}
+
+		if(!config_close_write())
+		{
+			string_append(parameters->dst, "> cannot set config (close)\n");
+			return(app_action_error);
+		}
+
+		effect_start(&new_effect);
+	}
+
+	string_append(parameters->dst, "> ledpixel effect: ");
+	string_append_cstr_flash(parameters->dst, effect_names[effect.type].name);
+	string_format(parameters->dst, ", period: %u ms, parameter: %u, frames: %u, colours:",
+			effect.period_ms, effect.parameter, effect.frames);
+
+	for(ix = 0; ix < effect.colours; ix++)
+		string_format(parameters->dst, " 0x%08x", (unsigned int)effect.colour[ix]);
+
+	string_append(parameters->dst, "\n");
+
+	return(app_action_normal);
+}
@@ -0,0 +1,23 @@
+#ifndef _ledpixel_effect_h_
+#define _ledpixel_effect_h_
+
+#include "util.h"
+#include "dispatch.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+enum
+{
+	ledpixel_effect_frame_ms = 20,
+	ledpixel_effect_colours_max = 4,
+	ledpixel_effect_period_max = 60000,
+};
+
+void	ledpixel_effect_init(void);
+void	ledpixel_effect_periodic(unsigned int rate_ms);
+void	ledpixel_effect_render(void);
+
+app_action_t application_function_ledpixel_effect(app_params_t *);
+
+#endif
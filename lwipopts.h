@@ -2,9 +2,9 @@
 
 #define MEM_SIZE					(9 * 1024)
 #define MEMP_NUM_PBUF				8
-#define MEMP_NUM_UDP_PCB			4
-#define MEMP_NUM_TCP_PCB			2
-#define MEMP_NUM_TCP_PCB_LISTEN		2
+#define MEMP_NUM_UDP_PCB			5
+#define MEMP_NUM_TCP_PCB			3
+#define MEMP_NUM_TCP_PCB_LISTEN		3
 #define MEMP_NUM_TCP_SEG			TCP_SND_QUEUELEN
 #define MEMP_NUM_REASSDATA			1
 #define MEMP_NUM_FRAG_PBUF			0
@@ -9,6 +9,116 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+typedef enum attr_packed
+{
+	fcs_idle,
+	fcs_running,
+	fcs_finished,
+	fcs_error,
+} flash_checksum_state_t;
+
+assert_size(flash_checksum_state_t, 1);
+
+typedef struct
+{
+	flash_checksum_state_t	state;
+	bool					stalled;
+	unsigned int			start;
+	unsigned int			sectors;
+	unsigned int			done;
+	SHA_CTX					context;
+	uint8_t					digest[SHA_DIGEST_LENGTH];
+} flash_checksum_t;
+
+static flash_checksum_t flash_checksum;
+
+enum
+{
+	flash_sectors_total = (MISC_FLASH_OFFSET + MISC_FLASH_SIZE) / SPI_FLASH_SEC_SIZE,
+	flash_erase_ahead_sectors_max = 256,
+	flash_erase_ahead_bitmap_words = flash_erase_ahead_sectors_max / 32,
+};
+
+typedef struct
+{
+	bool			running;
+	bool			stalled;
+	unsigned int	start;
+	unsigned int	sectors;
+	unsigned int	next;
+	unsigned int	erased;
+	unsigned int	skipped;
+	uint32_t		visited[flash_erase_ahead_bitmap_words];
+	uint32_t		blank[flash_erase_ahead_bitmap_words];
+} flash_erase_ahead_t;
+
+static flash_erase_ahead_t flash_erase_ahead;
+
+typedef struct
+{
+	unsigned int offset;
+	unsigned int size;
+} flash_area_t;
+
+assert_size(flash_area_t, 8);
+
+// areas written by the firmware itself, never erase these ahead
+
+roflash static const flash_area_t flash_erase_ahead_reserved[] =
+{
+	{ USER_CONFIG_OFFSET,		USER_CONFIG_SIZE		},
+	{ RFCAL_OFFSET,				RFCAL_SIZE				},
+	{ PHYDATA_OFFSET,			PHYDATA_SIZE			},
+	{ SYSTEM_CONFIG_OFFSET,		SYSTEM_CONFIG_SIZE		},
+	{ SEQUENCER_FLASH_OFFSET_0,	SEQUENCER_FLASH_SIZE	},
+	{ SEQUENCER_FLASH_OFFSET_1,	SEQUENCER_FLASH_SIZE	},
+};
+
+static bool erase_ahead_reserved(unsigned int sector, unsigned int sectors)
+{
+	unsigned int ix, start, end;
+	const flash_area_t *area;
+
+	for(ix = 0; ix < (sizeof(flash_erase_ahead_reserved) / sizeof(*flash_erase_ahead_reserved)); ix++)
+	{
+		area = &flash_erase_ahead_reserved[ix];
+
+		if(area->size == 0)
+			continue;
+
+		start = area->offset / SPI_FLASH_SEC_SIZE;
+		end = (area->offset + area->size + SPI_FLASH_SEC_SIZE - 1) / SPI_FLASH_SEC_SIZE;
+
+		if((sector < end) && ((sector + sectors) > start))
+			return(true);
+	}
+
+	return(false);
+}
+
+attr_inline bool erase_ahead_get(const uint32_t *bitmap, unsigned int index)
+{
+	return(!!(bitmap[index / 32] & (1UL << (index % 32))));
+}
+
+attr_inline void erase_ahead_set(uint32_t *bitmap, unsigned int index, bool value)
+{
+	if(value)
+		bitmap[index / 32] |= (1UL << (index % 32));
+	else
+		bitmap[index / 32] &= ~(1UL << (index % 32));
+}
+
+static bool erase_ahead_index(unsigned int sector, unsigned int *index)
+{
+	if((flash_erase_ahead.sectors == 0) || (sector < flash_erase_ahead.start) || (sector >= (flash_erase_ahead.start + flash_erase_ahead.sectors)))
+		return(false);
+
+	*index = sector - flash_erase_ahead.start;
+
+	return(true);
+}
+
 static app_action_t flash_all_finish(string_t *dst,
 		SpiFlashOpResult result, unsigned int sector,
 		const char *tag, const char *action)
@@ -162,6 +272,7 @@ app_action_t application_function_flash_write(app_params_t *parameters)
 	unsigned int mode;
 	unsigned int sector;
 	unsigned int word;
+	unsigned int index;
 	const unsigned int *wordptr;
 	int same;
 	int erase;
@@ -196,11 +307,23 @@ app_action_t application_function_flash_write(app_params_t *parameters)
 	old = (uint8_t *)string_buffer_nonconst(parameters->dst);
 	new = (const uint8_t *)string_buffer(parameters->src_oob);
 
+	erase = 0;
+
+	// Whatever happens, this sector should not be touched by the eraser anymore.
+	// The sector is always read back, even if the eraser marked it blank,
+	// because other writers (config, sequencer, rf calibration) don't update
+	// the bitmap. A pre-erased sector then simply needs no erase below.
+
+	if((mode == 1) && erase_ahead_index(sector, &index))
+	{
+		erase_ahead_set(flash_erase_ahead.visited, index, true);
+		erase_ahead_set(flash_erase_ahead.blank, index, false);
+	}
+
 	if((rv = flash_read(sector, old, "flash_write", parameters->dst)) != app_action_normal)
 		return(rv);
 
 	same = !memory_compare(SPI_FLASH_SEC_SIZE, old, new);
-	erase = 0;
 
 	if(!same)
 	{
@@ -279,6 +402,233 @@ app_action_t application_function_flash_checksum(app_params_t *parameters)
 	return(app_action_normal);
 }
 
+void flash_checksum_worker(void)
+{
+	string_t *buffer_string;
+	char *buffer_cstr;
+	unsigned int size;
+
+	if(flash_checksum.state != fcs_running)
+		return;
+
+	flash_buffer_request(fsb_flash_checksum, false, "flash checksum worker", &buffer_string, &buffer_cstr, &size);
+
+	if(!buffer_string)
+		goto retry; // buffer currently in use, try again later
+
+	if(spi_flash_read((flash_checksum.start + flash_checksum.done) * size, buffer_cstr, size) != SPI_FLASH_RESULT_OK)
+	{
+		log("[ota] flash checksum: failed to read sector 0x%x\n", flash_checksum.start + flash_checksum.done);
+		flash_checksum.state = fcs_error;
+		goto release;
+	}
+
+	SHA1Update(&flash_checksum.context, buffer_cstr, size);
+
+	if(++flash_checksum.done >= flash_checksum.sectors)
+	{
+		SHA1Final(flash_checksum.digest, &flash_checksum.context);
+		flash_checksum.state = fcs_finished;
+		goto release;
+	}
+
+retry:
+	flash_checksum.stalled = !dispatch_post_task(task_prio_low, task_flash_checksum_worker, 0, 0, 0);
+release:
+	if(flash_buffer_using_1(fsb_flash_checksum))
+		flash_buffer_release(fsb_flash_checksum, "flash checksum worker");
+}
+
+app_action_t application_function_flash_checksum_start(app_params_t *parameters)
+{
+	unsigned int sector, sectors;
+
+	if(parse_uint(1, parameters->src, &sector, 0, ' ') != parse_ok)
+	{
+		string_append(parameters->dst, "ERROR flash-checksum-start: start sector required\n");
+		return(app_action_error);
+	}
+
+	if(parse_uint(2, parameters->src, &sectors, 0, ' ') != parse_ok)
+	{
+		string_append(parameters->dst, "ERROR flash-checksum-start: length (sectors) required\n");
+		return(app_action_error);
+	}
+
+	if((sectors == 0) || (sector >= flash_sectors_total) || (sectors > (flash_sectors_total - sector)))
+	{
+		string_format(parameters->dst, "ERROR flash-checksum-start: invalid range, flash size is %u sectors\n", (unsigned int)flash_sectors_total);
+		return(app_action_error);
+	}
+
+	if(flash_checksum.state == fcs_running)
+		string_format(parameters->dst, "flash-checksum-start: aborted previous run at %u/%u sectors\n", flash_checksum.done, flash_checksum.sectors);
+
+	flash_checksum.state = fcs_running;
+	flash_checksum.start = sector;
+	flash_checksum.sectors = sectors;
+	flash_checksum.done = 0;
+	SHA1Init(&flash_checksum.context);
+
+	flash_checksum.stalled = !dispatch_post_task(task_prio_low, task_flash_checksum_worker, 0, 0, 0);
+
+	string_format(parameters->dst, "OK flash-checksum-start: checksumming %u sectors from sector %u\n", sectors, sector);
+
+	return(app_action_normal);
+}
+
+app_action_t application_function_flash_checksum_status(app_params_t *parameters)
+{
+	static roflash const char state_name[][12] =
+	{
+		"idle", "running", "finished", "error",
+	};
+
+	if((flash_checksum.state == fcs_running) && flash_checksum.stalled) // fallback for missed task posts
+		flash_checksum.stalled = !dispatch_post_task(task_prio_low, task_flash_checksum_worker, 0, 0, 0);
+
+	string_append(parameters->dst, "OK flash-checksum-status: ");
+	string_append_cstr_flash(parameters->dst, state_name[flash_checksum.state]);
+	string_format(parameters->dst, ", sector %u, sectors %u/%u", flash_checksum.start, flash_checksum.done, flash_checksum.sectors);
+
+	if(flash_checksum.state == fcs_finished)
+	{
+		string_append(parameters->dst, ", checksum: ");
+		string_bin_to_hex(parameters->dst, flash_checksum.digest, SHA_DIGEST_LENGTH);
+	}
+
+	string_append(parameters->dst, "\n");
+
+	return(app_action_normal);
+}
+
+void flash_erase_ahead_worker(void)
+{
+	string_t *buffer_string;
+	char *buffer_cstr;
+	unsigned int size, index, sector, word;
+	const uint32_t *wordptr;
+	bool blank;
+
+	if(!flash_erase_ahead.running)
+		return;
+
+	for(index = flash_erase_ahead.next; index < flash_erase_ahead.sectors; index++)
+		if(!erase_ahead_get(flash_erase_ahead.visited, index))
+			break;
+
+	if(index >= flash_erase_ahead.sectors)
+	{
+		flash_erase_ahead.running = false;
+		return;
+	}
+
+	flash_buffer_request(fsb_flash_erase_ahead, false, "flash erase ahead worker", &buffer_string, &buffer_cstr, &size);
+
+	if(!buffer_string)
+		goto retry; // buffer currently in use, try again later
+
+	sector = flash_erase_ahead.start + index;
+	flash_erase_ahead.next = index + 1;
+	erase_ahead_set(flash_erase_ahead.visited, index, true);
+
+	if(spi_flash_read(sector * size, buffer_cstr, size) != SPI_FLASH_RESULT_OK)
+	{
+		log("[ota] erase ahead: failed to read sector 0x%x\n", sector);
+		goto retry;
+	}
+
+	for(word = 0, wordptr = (const uint32_t *)(const void *)buffer_cstr, blank = true; word < (size / sizeof(*wordptr)); word++, wordptr++)
+	{
+		if(*wordptr != 0xffffffffUL)
+		{
+			blank = false;
+			break;
+		}
+	}
+
+	if(blank)
+		flash_erase_ahead.skipped++;
+	else
+	{
+		if(spi_flash_erase_sector(sector) != SPI_FLASH_RESULT_OK)
+		{
+			log("[ota] erase ahead: failed to erase sector 0x%x\n", sector);
+			goto retry;
+		}
+
+		flash_erase_ahead.erased++;
+	}
+
+	erase_ahead_set(flash_erase_ahead.blank, index, true);
+
+retry:
+	flash_erase_ahead.stalled = !dispatch_post_task(task_prio_low, task_flash_erase_ahead_worker, 0, 0, 0);
+
+	if(flash_buffer_using_1(fsb_flash_erase_ahead))
+		flash_buffer_release(fsb_flash_erase_ahead, "flash erase ahead worker");
+}
+
+app_action_t application_function_flash_erase_ahead(app_params_t *parameters)
+{
+	unsigned int sector, sectors, index, blank;
+	unsigned int image_start, image_end;
+
+	if(parse_uint(1, parameters->src, &sector, 0, ' ') == parse_ok)
+	{
+		if(parse_uint(2, parameters->src, &sectors, 0, ' ') != parse_ok)
+		{
+			string_append(parameters->dst, "ERROR flash-erase-ahead: length (sectors) required\n");
+			return(app_action_error);
+		}
+
+		if((sector >= flash_sectors_total) || (sectors > (flash_sectors_total - sector)) || (sectors > flash_erase_ahead_sectors_max))
+		{
+			string_format(parameters->dst, "ERROR flash-erase-ahead: invalid range, flash size is %u sectors, max %u sectors\n",
+					(unsigned int)flash_sectors_total, (unsigned int)flash_erase_ahead_sectors_max);
+			return(app_action_error);
+		}
+
+		image_start = ((rboot_if_mapped_slot() * 0x100000) + OFFSET_IMG_0) / SPI_FLASH_SEC_SIZE;
+		image_end = image_start + (SIZE_IMG / SPI_FLASH_SEC_SIZE);
+
+		if((sectors > 0) && ((sector < (OFFSET_IMG_0 / SPI_FLASH_SEC_SIZE)) || ((sector < image_end) && ((sector + sectors) > image_start))))
+		{
+			string_append(parameters->dst, "ERROR flash-erase-ahead: range overlaps boot sectors or running image\n");
+			return(app_action_error);
+		}
+
+		if((sectors > 0) && erase_ahead_reserved(sector, sectors))
+		{
+			string_append(parameters->dst, "ERROR flash-erase-ahead: range overlaps config, rf calibration, system or sequencer sectors\n");
+			return(app_action_error);
+		}
+
+		memset(&flash_erase_ahead, 0, sizeof(flash_erase_ahead));
+
+		if(sectors > 0)
+		{
+			flash_erase_ahead.running = true;
+			flash_erase_ahead.start = sector;
+			flash_erase_ahead.sectors = sectors;
+			flash_erase_ahead.stalled = !dispatch_post_task(task_prio_low, task_flash_erase_ahead_worker, 0, 0, 0);
+		}
+	}
+	else
+		if(flash_erase_ahead.running && flash_erase_ahead.stalled) // fallback for missed task posts
+			flash_erase_ahead.stalled = !dispatch_post_task(task_prio_low, task_flash_erase_ahead_worker, 0, 0, 0);
+
+	for(index = 0, blank = 0; index < flash_erase_ahead.sectors; index++)
+		if(erase_ahead_get(flash_erase_ahead.blank, index))
+			blank++;
+
+	string_format(parameters->dst, "OK flash-erase-ahead: sector %u, sectors %u, running %u, blank %u, erased %u, already blank %u\n",
+			flash_erase_ahead.start, flash_erase_ahead.sectors, flash_erase_ahead.running, blank,
+			flash_erase_ahead.erased, flash_erase_ahead.skipped);
+
+	return(app_action_normal);
+}
+
 app_action_t application_function_flash_bench(app_params_t *parameters)
 {
 	unsigned int bytes, pad_offset, oob_offset;
@@ -76,8 +76,13 @@ app_action_t application_function_flash_info(app_params_t *);
 app_action_t application_function_flash_write(app_params_t *);
 app_action_t application_function_flash_read(app_params_t *);
 app_action_t application_function_flash_checksum(app_params_t *);
+app_action_t application_function_flash_checksum_start(app_params_t *);
+app_action_t application_function_flash_checksum_status(app_params_t *);
+app_action_t application_function_flash_erase_ahead(app_params_t *);
 app_action_t application_function_flash_bench(app_params_t *);
 app_action_t application_function_flash_select(app_params_t *);
+void flash_checksum_worker(void);
+void flash_erase_ahead_worker(void);
 #endif
 
 #endif
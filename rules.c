@@ -0,0 +1,524 @@
+#include "attribute.h"
+#include "rules.h"
+#include "io.h"
+#include "i2c_sensor.h"
+#include "config.h"
+#include "sys_time.h"
+
+// Rules are stored in config as text, one per index, e.g.
+//		pin 0 4 rise if sensor 0 14 gt 25 then 0 12 on 5000
+// and compiled at boot (and on change) into a compact table.
+// "pin" rules are evaluated from io_pin_changed, "sensor" rules each time the
+// background sensor scan completes. An optional duration reverts the action.
+
+typedef enum
+{
+	rule_term_none,
+	rule_term_pin,
+	rule_term_sensor,
+} rule_term_type_t;
+
+typedef enum
+{
+	rule_op_rise,
+	rule_op_fall,
+	rule_op_change,
+	rule_op_on,
+	rule_op_off,
+	rule_op_gt,
+	rule_op_lt,
+	rule_op_size,
+	rule_op_error = rule_op_size,
+} rule_op_t;
+
+typedef struct
+{
+	uint8_t	type;
+	uint8_t	op;
+	uint8_t	io;			// io or i2c bus
+	uint8_t	pin;		// pin or sensor
+	int32_t	value;		// sensor threshold, in thousandths
+} rule_term_t;
+
+assert_size(rule_term_t, 8);
+
+typedef struct
+{
+	rule_term_t	when;
+	rule_term_t	condition;
+	uint8_t		target_io;
+	uint8_t		target_pin;
+	uint8_t		action;
+	uint8_t		index:7;	// config entry
+	uint8_t		state:1;	// last sensor comparison result, to fire on the edge only
+	uint32_t	duration_ms;
+	uint32_t	expire_ms;	// != 0: revert action pending
+	uint32_t	fired;
+} rule_t;
+
+assert_size(rule_t, 32);
+
+typedef struct
+{
+	unsigned int	count;
+	rule_t			rule[rules_max];
+} rules_t;
+
+static rules_t rules;
+
+typedef struct
+{
+	uint8_t		index;
+	uint8_t		target_io;
+	uint8_t		target_pin;
+	uint8_t		action;
+	uint32_t	expire_ms;
+} rule_pending_t;
+
+assert_size(rule_pending_t, 8);
+
+typedef struct
+{
+	const char		name[8];
+	rule_op_t		op;
+} rule_op_name_t;
+
+assert_size(rule_op_name_t, 12);
+
+roflash static const rule_op_name_t rule_op_names[rule_op_size] =
+{
+	{ "rise",	rule_op_rise	},
+	{ "fall",	rule_op_fall	},
+	{ "change",	rule_op_change	},
+	{ "on",		rule_op_on		},
+	{ "off",	rule_op_off		},
+	{ "gt",		rule_op_gt		},
+	{ "lt",		rule_op_lt		},
+};
+
+static rule_op_t rule_op_from_string(const string_t *src)
+{
+	unsigned int ix;
+	const rule_op_name_t *entry;
+
+	for(ix = 0; ix < rule_op_size; ix++)
+	{
+		entry = &rule_op_names[ix];
+
+		if(string_match_cstr_flash(src, entry->name))
+			return(entry->op);
+	}
+
+	return(rule_op_error);
+}
+
+static io_trigger_t rule_action_reverse(io_trigger_t action)
+{
+	switch(action)
+	{
+		case(io_trigger_on):		return(io_trigger_off);
+		case(io_trigger_off):		return(io_trigger_on);
+		case(io_trigger_up):		return(io_trigger_down);
+		case(io_trigger_down):		return(io_trigger_up);
+		case(io_trigger_start):		return(io_trigger_stop);
+		case(io_trigger_stop):		return(io_trigger_start);
+		case(io_trigger_toggle):	return(io_trigger_toggle);
+		default:					return(io_trigger_none);
+	}
+}
+
+// <pin <io> <pin> <op>> | <sensor <bus> <sensor> <op> <value>>, returns the index of the next token or -1
+
+static int rule_compile_term(const string_t *src, int index, rule_term_t *term, bool condition)
+{
+	string_new(, token, 16);
+	unsigned int io, pin;
+	double value;
+
+	if(parse_string(index++, src, &token, ' ') != parse_ok)
+		return(-1);
+
+	if(string_match_cstr(&token, "pin"))
+		term->type = rule_term_pin;
+	else if(string_match_cstr(&token, "sensor"))
+		term->type = rule_term_sensor;
+	else
+		return(-1);
+
+	if((parse_uint(index++, src, &io, 0, ' ') != parse_ok) || (parse_uint(index++, src, &pin, 0, ' ') != parse_ok))
+		return(-1);
+
+	string_clear(&token);
+
+	if(parse_string(index++, src, &token, ' ') != parse_ok)
+		return(-1);
+
+	if((term->op = rule_op_from_string(&token)) == rule_op_error)
+		return(-1);
+
+	term->io = io;
+	term->pin = pin;
+	term->value = 0;
+
+	if(term->type == rule_term_pin)
+	{
+		if(condition ? ((term->op != rule_op_on) && (term->op != rule_op_off)) : (term->op > rule_op_change))
+			return(-1);
+
+		if(io >= io_id_size)
+			return(-1);
+	}
+	else
+	{
+		if((term->op != rule_op_gt) && (term->op != rule_op_lt))
+			return(-1);
+
+		if(pin >= i2c_sensor_size)
+			return(-1);
+
+		if(parse_float(index++, src, &value, ' ') != parse_ok)
+			return(-1);
+
+		term->value = (int32_t)(value * 1000);
+	}
+
+	return(index);
+}
+
+// <term> [if <term>] then <io> <pin> <action> [<duration ms>]
+
+static bool rule_compile(const string_t *src, rule_t *rule)
+{
+	string_new(, token, 16);
+	unsigned int io, pin, duration;
+	int index;
+	io_trigger_t action;
+
+	rule->condition.type = rule_term_none;
+
+	if((index = rule_compile_term(src, 0, &rule->when, false)) < 0)
+		return(false);
+
+	if(parse_string(index++, src, &token, ' ') != parse_ok)
+		return(false);
+
+	if(string_match_cstr(&token, "if"))
+	{
+		if((index = rule_compile_term(src, index, &rule->condition, true)) < 0)
+			return(false);
+
+		string_clear(&token);
+
+		if(parse_string(index++, src, &token, ' ') != parse_ok)
+			return(false);
+	}
+
+	if(!string_match_cstr(&token, "then"))
+		return(false);
+
+	if((parse_uint(index++, src, &io, 0, ' ') != parse_ok) || (parse_uint(index++, src, &pin, 0, ' ') != parse_ok))
+		return(false);
+
+	if(io >= io_id_size)
+		return(false);
+
+	string_clear(&token);
+
+	if(parse_string(index++, src, &token, ' ') != parse_ok)
+		return(false);
+
+	if((action = string_to_trigger_action(&token)) == io_trigger_error)
+		return(false);
+
+	if(parse_uint(index, src, &duration, 0, ' ') != parse_ok)
+		duration = 0;
+
+	rule->target_io = io;
+	rule->target_pin = pin;
+	rule->action = action;
+	rule->state = 0;
+	rule->duration_ms = duration;
+	rule->expire_ms = 0;
+	rule->fired = 0;
+
+	return(true);
+}
+
+static bool rule_sensor_compare(const rule_term_t *term)
+{
+	double value;
+
+	if(!i2c_sensor_get_value(term->io, (i2c_sensor_t)term->pin, &value))
+		return(false);
+
+	if(term->op == rule_op_gt)
+		return((int32_t)(value * 1000) > term->value);
+
+	return((int32_t)(value * 1000) < term->value);
+}
+
+static bool rule_condition(const rule_t *rule)
+{
+	unsigned int value;
+
+	switch(rule->condition.type)
+	{
+		case(rule_term_pin):
+		{
+			if(io_read_pin((string_t *)0, rule->condition.io, rule->condition.pin, &value) != io_ok)
+				return(false);
+
+			return((rule->condition.op == rule_op_on) == !!value);
+		}
+
+		case(rule_term_sensor):
+		{
+			return(rule_sensor_compare(&rule->condition));
+		}
+
+		default:
+		{
+			return(true);
+		}
+	}
+}
+
+static void rule_fire(rule_t *rule)
+{
+	if(!rule_condition(rule))
+		return;
+
+	rule->fired++;
+
+	io_trigger_pin((string_t *)0, rule->target_io, rule->target_pin, rule->action);
+
+	if(rule->duration_ms > 0)
+		rule->expire_ms = ((uint32_t)(time_get_us() / 1000) + rule->duration_ms) | 1;
+}
+
+void rules_init(void)
+{
+	unsigned int index, pending_index, pending_count;
+	string_new(, text, 64);
+	rule_t *rule;
+	rule_pending_t pending[rules_max];
+
+	// recompiling must not lose actions that still need to be reverted
+
+	for(index = 0, pending_count = 0; index < rules.count; index++)
+	{
+		rule = &rules.rule[index];
+
+		if(!rule->expire_ms)
+			continue;
+
+		pending[pending_count].index = rule->index;
+		pending[pending_count].target_io = rule->target_io;
+		pending[pending_count].target_pin = rule->target_pin;
+		pending[pending_count].action = rule->action;
+		pending[pending_count].expire_ms = rule->expire_ms;
+		pending_count++;
+	}
+
+	rules.count = 0;
+
+	for(index = 0; index < rules_max; index++)
+	{
+		string_clear(&text);
+
+		if(!config_get_string("rule.%u", &text, index, -1))
+			continue;
+
+		rule = &rules.rule[rules.count];
+
+		if(!rule_compile(&text, rule))
+		{
+			log("rules: rule %u invalid\n", index);
+			continue;
+		}
+
+		rule->index = index;
+		rules.count++;
+	}
+
+	// an unchanged rule keeps its pending revert, otherwise the action is reverted right away
+
+	for(pending_index = 0; pending_index < pending_count; pending_index++)
+	{
+		for(index = 0; index < rules.count; index++)
+		{
+			rule = &rules.rule[index];
+
+			if((rule->index == pending[pending_index].index) &&
+					(rule->target_io == pending[pending_index].target_io) &&
+					(rule->target_pin == pending[pending_index].target_pin) &&
+					(rule->action == pending[pending_index].action) &&
+					(rule->duration_ms > 0))
+				break;
+		}
+
+		if(index < rules.count)
+			rule->expire_ms = pending[pending_index].expire_ms;
+		else
+			io_trigger_pin((string_t *)0, pending[pending_index].target_io, pending[pending_index].target_pin,
+					rule_action_reverse(pending[pending_index].action));
+	}
+}
+
+void rules_pin_changed(unsigned int io, unsigned int pin, bool level)
+{
+	unsigned int index;
+	rule_t *rule;
+
+	for(index = 0; index < rules.count; index++)
+	{
+		rule = &rules.rule[index];
+
+		if((rule->when.type != rule_term_pin) || (rule->when.io != io) || (rule->when.pin != pin))
+			continue;
+
+		if(((rule->when.op == rule_op_rise) && !level) || ((rule->when.op == rule_op_fall) && level))
+			continue;
+
+		rule_fire(rule);
+	}
+}
+
+void rules_sensors_updated(void)
+{
+	unsigned int index;
+	rule_t *rule;
+	bool state;
+
+	for(index = 0; index < rules.count; index++)
+	{
+		rule = &rules.rule[index];
+
+		if(rule->when.type != rule_term_sensor)
+			continue;
+
+		state = rule_sensor_compare(&rule->when);
+
+		if(state && !rule->state)
+			rule_fire(rule);
+
+		rule->state = state;
+	}
+}
+
+void rules_periodic(void)
+{
+	unsigned int index;
+	uint32_t now;
+	rule_t *rule;
+
+	now = (uint32_t)(time_get_us() / 1000);
+
+	for(index = 0; index < rules.count; index++)
+	{
+		rule = &rules.rule[index];
+
+		if(!rule->expire_ms || ((int32_t)(now - rule->expire_ms) < 0))
+			continue;
+
+		rule->expire_ms = 0;
+		io_trigger_pin((string_t *)0, rule->target_io, rule->target_pin, rule_action_reverse(rule->action));
+	}
+}
+
+app_action_t application_function_rule_set(app_params_t *parameters)
+{
+	unsigned int index;
+	int offset;
+	string_new(, text, 64);
+	rule_t rule;
+
+	if(parse_uint(1, parameters->src, &index, 0, ' ') != parse_ok)
+	{
+		string_append(parameters->dst, "> usage: rule-set <index> [<when> [if <condition>] then <io> <pin> <action> [<duration ms>]]\n");
+		string_append(parameters->dst, ">   <when>: pin <io> <pin> rise|fall|change, or sensor <bus> <sensor> gt|lt <value>\n");
+		string_append(parameters->dst, ">   <condition>: pin <io> <pin> on|off, or sensor <bus> <sensor> gt|lt <value>\n");
+		return(app_action_error);
+	}
+
+	if(index >= rules_max)
+	{
+		string_format(parameters->dst, "> rule index must be between 0 and %u\n", rules_max - 1);
+		return(app_action_error);
+	}
+
+	if((offset = string_sep(parameters->src, 0, 2, ' ')) > 0)
+	{
+		string_splice(&text, 0, parameters->src, offset, -1);
+		string_trim_nl(&text);
+	}
+
+	if(!string_empty(&text) && !rule_compile(&text, &rule))
+	{
+		string_append(parameters->dst, "> rule invalid\n");
+		return(app_action_error);
+	}
+
+	if(!config_open_write())
+	{
+		string_append(parameters->dst, "> cannot set config (open)\n");
+		return(app_action_error);
+	}
+
+	config_delete("rule.%u", false, index, -1);
+
+	if(!string_empty(&text) && !config_set_string("rule.%u", string_to_cstr(&text), index, -1))
+	{
+		config_abort_write();
+		string_append(parameters->dst, "> cannot set config\n");
+		return(app_action_error);
+	}
+
+	if(!config_close_write())
+	{
+		string_append(parameters->dst, "> cannot set config (close)\n");
+		return(app_action_error);
+	}
+
+	rules_init();
+
+	string_format(parameters->dst, "> rule %u %s, %u rules active\n", index, string_empty(&text) ? "deleted" : "set", rules.count);
+
+	return(app_action_normal);
+}
+
+app_action_t application_function_rule_list(app_params_t *parameters)
+{
+	unsigned int index, compiled;
+	string_new(, text, 64);
+	const rule_t *rule;
+
+	for(index = 0; index < rules_max; index++)
+	{
+		string_clear(&text);
+
+		if(!config_get_string("rule.%u", &text, index, -1))
+			continue;
+
+		string_format(parameters->dst, "> %2u: %s", index, string_to_cstr(&text));
+
+		for(compiled = 0; compiled < rules.count; compiled++)
+		{
+			rule = &rules.rule[compiled];
+
+			if(rule->index == index)
+				break;
+		}
+
+		if(compiled < rules.count)
+			string_format(parameters->dst, " [fired: %u%s]", rule->fired, rule->expire_ms ? ", active" : "");
+		else
+			string_append(parameters->dst, " [invalid]");
+
+		string_append(parameters->dst, "\n");
+	}
+
+	string_format(parameters->dst, "> %u rules active\n", rules.count);
+
+	return(app_action_normal);
+}
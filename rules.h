@@ -0,0 +1,23 @@
+#ifndef _rules_h_
+#define _rules_h_
+
+#include "util.h"
+#include "dispatch.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+enum
+{
+	rules_max = 16,
+};
+
+void	rules_init(void);
+void	rules_pin_changed(unsigned int io, unsigned int pin, bool level);
+void	rules_sensors_updated(void);
+void	rules_periodic(void);
+
+app_action_t application_function_rule_set(app_params_t *);
+app_action_t application_function_rule_list(app_params_t *);
+
+#endif
@@ -2,21 +2,67 @@
 #include "sys_time.h"
 #include "io.h"
 #include "dispatch.h"
+#include "config.h"
 
 #include <stdint.h>
 #include <stdbool.h>
 
+enum
+{
+	ramp_lanes_max = 4,
+};
+
+typedef struct
+{
+	sequencer_ramp_t	type;
+	unsigned int		io;
+	unsigned int		pin;
+	unsigned int		lanes;
+	unsigned int		from[ramp_lanes_max];	// for gamma ramps these are square roots, scaled up by shift / 2 bits
+	unsigned int		to[ramp_lanes_max];
+	unsigned int		shift;
+	unsigned int		target;
+	unsigned int		last;
+	uint64_t			start_time;
+	unsigned int		duration;
+} sequencer_ramp_state_t;
+
+typedef struct
+{
+	unsigned int		valid:1;
+	unsigned int		wrap:1;
+	unsigned int		index;
+	int					io;
+	int					pin;
+	unsigned int		value;
+	unsigned int		duration;
+	sequencer_ramp_t	ramp;
+} sequencer_prefetch_t;
+
+typedef struct
+{
+	int						start;
+	int						current;
+	uint64_t				current_end_time;	// us
+	int						repeats;
+	sequencer_prefetch_t	next;
+	sequencer_ramp_state_t	ramp;
+} sequencer_track_t;
+
 typedef struct
 {
-	bool		flash_valid;
-	int			start;
-	int			current;
-	uint64_t	current_end_time;
-	int			repeats;
+	bool				flash_valid;
+	os_timer_t			timer;
+	unsigned int		late_last_us;
+	unsigned int		late_max_us;
+	sequencer_track_t	track[sequencer_tracks];
 } sequencer_t;
 
 static sequencer_t sequencer;
 
+static void track_prefetch(sequencer_track_t *tp);
+static void timer_callback(void *arg);
+
 typedef struct
 {
 	union
@@ -26,7 +72,8 @@ typedef struct
 			unsigned int active:1;
 			unsigned int io:4;
 			unsigned int pin:4;
-			unsigned int duration:23;
+			unsigned int duration:21;
+			unsigned int ramp:2;		// was the top of a 23 bit duration, zero for existing entries
 			unsigned int value:32;
 		};
 		struct
@@ -52,11 +99,32 @@ enum
 	sequencer_flash_entries = sequencer_flash_size / sizeof(sequencer_entry_t),
 	sequencer_flash_entries_per_sector = sequencer_flash_entries / sequencer_flash_sectors,
 	sequencer_flash_memory_map_start = 0x40200000,
+	sequencer_duration_max = (1 << 21) - 1,
+	sequencer_early_max_us = 1000,	// the timer has ms resolution, entries due within this time are run right away
+	sequencer_spin_max_us = 50,		// only busy-wait when the deadline is this close
+	sequencer_cache_entries = 64,
 };
 
 _Static_assert(sequencer_flash_entries == 2048, "flash sequencer size incorrect");
 _Static_assert(sequencer_flash_entries_per_sector == 512, "flash sequencer per sector size incorrect");
 
+typedef struct
+{
+	bool				valid;
+	bool				refill_posted;
+	unsigned int		first;	// flash index, including the header
+	unsigned int		hits;
+	unsigned int		misses;
+	sequencer_entry_t	entry[sequencer_cache_entries];
+} sequencer_cache_t;
+
+static sequencer_cache_t cache;
+
+attr_inline bool cache_contains(unsigned int index)
+{
+	return(cache.valid && (index >= cache.first) && (index < (cache.first + sequencer_cache_entries)));
+}
+
 static bool clear_all_flash_entries(unsigned int mirror)
 {
 	bool success;
@@ -104,6 +172,7 @@ static bool clear_all_flash_entries(unsigned int mirror)
 			entry->active = 0;
 			entry->io = 0;
 			entry->pin = 0;
+			entry->ramp = sequencer_ramp_none;
 			entry->duration = 0;
 			entry->value = current++;
 		}
@@ -136,6 +205,16 @@ static bool get_flash_entry(unsigned int index, sequencer_entry_t *entry)
 	if(index >= sequencer_flash_entries)
 		return(false);
 
+	if(cache_contains(index))
+	{
+		cache.hits++;
+		*entry = cache.entry[index - cache.first];
+		return(true);
+	}
+
+	if(cache.valid)
+		cache.misses++;
+
 	// note: this will always use either mirror 0 or mirror 1 depending on which image/slot is loaded, due to the flash mapping window
 	entries_in_flash = (const sequencer_entry_t *)(sequencer_flash_memory_map_start + SEQUENCER_FLASH_OFFSET_0);
 
@@ -146,6 +225,26 @@ static bool get_flash_entry(unsigned int index, sequencer_entry_t *entry)
 	return(true);
 }
 
+static void cache_fill(unsigned int first)
+{
+	unsigned int index;
+
+	cache.valid = false;
+
+	if(!config_flags_match(flag_sequencer_cache))
+		return;
+
+	if((first + sequencer_cache_entries) > sequencer_flash_entries)
+		first = sequencer_flash_entries - sequencer_cache_entries;
+
+	for(index = 0; index < sequencer_cache_entries; index++)
+		if(!get_flash_entry(first + index, &cache.entry[index]))
+			return;
+
+	cache.first = first;
+	cache.valid = true;
+}
+
 static bool update_flash_entry(unsigned int index, unsigned int mirror, const sequencer_entry_t *entry)
 {
 	bool success;
@@ -209,6 +308,9 @@ static bool update_flash_entry(unsigned int index, unsigned int mirror, const se
 	if(spi_flash_write(flash_start_offset + (sector * size), buffer_cstr, size) != SPI_FLASH_RESULT_OK)
 		goto error1;
 
+	if(cache_contains(index))
+		cache.entry[index - cache.first] = *entry;
+
 	success = true;
 
 error1:
@@ -217,31 +319,52 @@ error2:
 	return(success);
 }
 
-attr_pure int sequencer_get_start(void)
+attr_pure int sequencer_get_start(unsigned int track)
 {
-	return(sequencer.start);
+	if(track >= sequencer_tracks)
+		return(-1);
+
+	return(sequencer.track[track].start);
 }
 
-attr_pure int sequencer_get_current(void)
+attr_pure int sequencer_get_current(unsigned int track)
 {
-	return(sequencer.current);
+	if(track >= sequencer_tracks)
+		return(-1);
+
+	return(sequencer.track[track].current);
 }
 
-iram attr_pure uint64_t sequencer_get_current_end_time(void)
+attr_pure uint64_t sequencer_get_current_end_time(unsigned int track)
 {
-	return(sequencer.current_end_time);
+	if(track >= sequencer_tracks)
+		return(0);
+
+	return(sequencer.track[track].current_end_time / 1000);
 }
 
-iram attr_pure int sequencer_get_repeats(void)
+attr_pure int sequencer_get_repeats(unsigned int track)
 {
-	return(sequencer.repeats);
+	if(track >= sequencer_tracks)
+		return(0);
+
+	return(sequencer.track[track].repeats);
 }
 
-void sequencer_get_status(bool *running, unsigned int *start, unsigned int *flash_size, unsigned int *flash_size_entries,
-		unsigned int *flash_offset_flash0, unsigned int *flash_offset_flash1, unsigned int *flash_offset_mapped)
+void sequencer_get_status(bool *running, unsigned int *tracks, unsigned int *late_last_us, unsigned int *late_max_us, unsigned int *flash_size,
+		unsigned int *flash_size_entries, unsigned int *flash_offset_flash0, unsigned int *flash_offset_flash1, unsigned int *flash_offset_mapped)
 {
-	*running = sequencer.repeats > 0;
-	*start = sequencer.start;
+	unsigned int track;
+
+	*running = false;
+
+	for(track = 0; track < sequencer_tracks; track++)
+		if(sequencer.track[track].repeats > 0)
+			*running = true;
+
+	*tracks = sequencer_tracks;
+	*late_last_us = sequencer.late_last_us;
+	*late_max_us = sequencer.late_max_us;
 	*flash_size = sequencer_flash_sectors * SPI_FLASH_SEC_SIZE;
 	*flash_size_entries = sequencer_flash_entries;
 	*flash_offset_flash0 = SEQUENCER_FLASH_OFFSET_0;
@@ -261,7 +384,7 @@ bool sequencer_clear(void)
 	return(sequencer.flash_valid);
 }
 
-bool sequencer_get_entry(unsigned int index, bool *active, int *io, int *pin, unsigned int *value, unsigned int *duration)
+bool sequencer_get_entry(unsigned int index, bool *active, int *io, int *pin, unsigned int *value, unsigned int *duration, sequencer_ramp_t *ramp)
 {
 	sequencer_entry_t entry;
 
@@ -291,10 +414,13 @@ bool sequencer_get_entry(unsigned int index, bool *active, int *io, int *pin, un
 	if(value)
 		*value = entry.value;
 
+	if(ramp)
+		*ramp = (entry.ramp < sequencer_ramp_size) ? entry.ramp : sequencer_ramp_none;
+
 	return(true);
 }
 
-bool sequencer_set_entry(unsigned int index, int io, int pin, uint32_t value, int duration)
+bool sequencer_set_entry(unsigned int index, int io, int pin, uint32_t value, unsigned int duration, sequencer_ramp_t ramp)
 {
 	sequencer_entry_t entry;
 
@@ -306,9 +432,13 @@ bool sequencer_set_entry(unsigned int index, int io, int pin, uint32_t value, in
 	if(index >= sequencer_flash_entries)
 		return(false);
 
+	if((duration > sequencer_duration_max) || (ramp >= sequencer_ramp_size))
+		return(false);
+
 	entry.active = 1;
 	entry.io = io;
 	entry.pin = pin;
+	entry.ramp = ramp;
 	entry.duration = duration;
 	entry.value = value;
 
@@ -333,6 +463,7 @@ bool sequencer_remove_entry(unsigned int index)
 	entry.active = 0;
 	entry.io = 0;
 	entry.pin = 0;
+	entry.ramp = sequencer_ramp_none;
 	entry.duration = 0;
 	entry.value = 0;
 
@@ -342,60 +473,495 @@ bool sequencer_remove_entry(unsigned int index)
 	return(update_flash_entry(index, 1, &entry));
 }
 
+// replace a complete sector of entries in both mirrors, sector 0 starts with the header, which is always (re)written here
+
+bool sequencer_upload(unsigned int sector, unsigned int length, void *data)
+{
+	sequencer_entry_t *entries;
+	unsigned int mirror, offset, index;
+
+	if((sector >= sequencer_flash_sectors) || (length != SPI_FLASH_SEC_SIZE))
+		return(false);
+
+	if(!sequencer.flash_valid && (sector != 0))
+		return(false);
+
+	entries = (sequencer_entry_t *)data;
+
+	if(sector == 0)
+	{
+		entries[0].magic = sequencer_flash_magic;
+		entries[0].version = sequencer_flash_version;
+	}
+
+	for(index = (sector == 0) ? 1 : 0; index < sequencer_flash_entries_per_sector; index++)
+		if(entries[index].active && (entries[index].ramp >= sequencer_ramp_size))
+			return(false);
+
+	sequencer_stop_all();
+	cache.valid = false;
+
+	// an upload starts with sector 0, clear the other sectors first so playback can't run into
+	// an old sequence or into erased flash, which reads as active entries
+
+	if(sector == 0)
+	{
+		sequencer.flash_valid = 0;
+
+		for(mirror = 0; mirror < 2; mirror++)
+			if(!clear_all_flash_entries(mirror))
+				return(false);
+	}
+
+	for(mirror = 0; mirror < 2; mirror++)
+	{
+		offset = (mirror == 0) ? SEQUENCER_FLASH_OFFSET_0 : SEQUENCER_FLASH_OFFSET_1;
+
+		if(offset == 0) // plain image, no mirror offset
+			continue;
+
+		offset += sector * SPI_FLASH_SEC_SIZE;
+
+		if(spi_flash_erase_sector(offset / SPI_FLASH_SEC_SIZE) != SPI_FLASH_RESULT_OK)
+			return(false);
+
+		if(spi_flash_write(offset, data, SPI_FLASH_SEC_SIZE) != SPI_FLASH_RESULT_OK)
+			return(false);
+	}
+
+	if(sector == 0)
+		sequencer.flash_valid = 1;
+
+	return(true);
+}
+
+// move the window to the next entry of the only running track, with more tracks it stays where it was loaded by sequencer_start
+
+void sequencer_cache_refill(void)
+{
+	unsigned int track, running;
+	const sequencer_track_t *tp;
+
+	cache.refill_posted = false;
+
+	for(track = 0, running = 0, tp = (const sequencer_track_t *)0; track < sequencer_tracks; track++)
+	{
+		if(sequencer.track[track].repeats > 0)
+		{
+			tp = &sequencer.track[track];
+			running++;
+		}
+	}
+
+	if((running != 1) || !tp->next.valid || cache_contains(tp->next.index + 1))
+		return;
+
+	cache_fill(tp->next.index + 1);
+}
+
+void sequencer_get_cache_status(bool *enabled, bool *valid, unsigned int *first, unsigned int *entries, unsigned int *hits, unsigned int *misses)
+{
+	*enabled = !!config_flags_match(flag_sequencer_cache);
+	*valid = cache.valid;
+	*first = cache.first > 0 ? cache.first - 1 : 0;
+	*entries = sequencer_cache_entries;
+	*hits = cache.hits;
+	*misses = cache.misses;
+}
+
 void sequencer_init(void)
 {
 	sequencer_entry_t header;
 
-	sequencer_stop();
+	os_timer_disarm(&sequencer.timer);
+	os_timer_setfn(&sequencer.timer, timer_callback, (void *)0);
+
+	sequencer_stop_all();
 
 	sequencer.flash_valid = 0;
+	sequencer.late_last_us = 0;
+	sequencer.late_max_us = 0;
+	cache.valid = false;
 
 	if(get_flash_entry(0, &header) && (header.magic == sequencer_flash_magic) && (header.version == sequencer_flash_version))
 		sequencer.flash_valid = 1;
 }
 
-void sequencer_start(unsigned int start, unsigned int repeats)
+bool sequencer_start(unsigned int track, unsigned int start, unsigned int repeats)
+{
+	sequencer_track_t *tp;
+	unsigned int other;
+
+	if(track >= sequencer_tracks)
+		return(false);
+
+	// load the cache with the window starting at this track's first entry, unless another running track is still playing from it
+
+	if(!cache_contains(start + 1))
+	{
+		for(other = 0; other < sequencer_tracks; other++)
+			if((other != track) && (sequencer.track[other].repeats > 0) && cache_contains(sequencer.track[other].current + 1))
+				break;
+
+		if(other >= sequencer_tracks)
+			cache_fill(start + 1);
+	}
+
+	tp = &sequencer.track[track];
+
+	tp->start = start;
+	tp->current = tp->start - 1;
+	tp->current_end_time = 0;
+	tp->repeats = repeats;
+	tp->ramp.type = sequencer_ramp_none;
+
+	track_prefetch(tp);
+
+	dispatch_post_task(task_prio_high, task_run_sequencer, 0, 0, 0);
+
+	return(true);
+}
+
+bool sequencer_stop(unsigned int track)
 {
-	sequencer.start = start;
-	sequencer.current = sequencer.start - 1;
-	sequencer.current_end_time = 0;
-	sequencer.repeats = repeats;
+	sequencer_track_t *tp;
+
+	if(track >= sequencer_tracks)
+		return(false);
+
+	tp = &sequencer.track[track];
+
+	tp->start = 0;
+	tp->current = -1;
+	tp->current_end_time = 0;
+	tp->repeats = 0;
+	tp->next.valid = 0;
+	tp->ramp.type = sequencer_ramp_none;
+
+	return(true);
 }
 
-void sequencer_stop(void)
+void sequencer_stop_all(void)
 {
-	sequencer.start = 0;
-	sequencer.current = -1;
-	sequencer.current_end_time = 0;
-	sequencer.repeats = 0;
+	unsigned int track;
+
+	for(track = 0; track < sequencer_tracks; track++)
+		sequencer_stop(track);
 }
 
-void sequencer_run(void)
+roflash static const char ramp_name[sequencer_ramp_size][8] =
 {
-	int io, pin;
-	unsigned int value, duration;
-	bool active;
+	"step",
+	"linear",
+	"gamma",
+};
 
-	sequencer.current++;
+bool sequencer_ramp_from_string(const string_t *src, sequencer_ramp_t *ramp)
+{
+	sequencer_ramp_t current;
 
-	if(!sequencer_get_entry(sequencer.current, &active, &io, &pin, &value, &duration) || !active)
+	for(current = sequencer_ramp_none; current < sequencer_ramp_size; current++)
 	{
-		if(--sequencer.repeats <= 0)
+		if(string_match_cstr_flash(src, ramp_name[current]))
 		{
-			sequencer_stop();
-			return;
+			*ramp = current;
+			return(true);
 		}
+	}
 
-		sequencer.current = sequencer.start;
+	return(false);
+}
 
-		if(!sequencer_get_entry(sequencer.current, &active, &io, &pin, &value, &duration) || !active)
+void sequencer_ramp_to_string(string_t *dst, sequencer_ramp_t ramp)
+{
+	if(ramp >= sequencer_ramp_size)
+		string_append(dst, "<invalid>");
+	else
+		string_append_cstr_flash(dst, ramp_name[ramp]);
+}
+
+static unsigned int isqrt(uint32_t value)
+{
+	unsigned int root, bit;
+
+	root = 0;
+
+	for(bit = 1 << 15; bit > 0; bit >>= 1)
+		if(((root | bit) * (root | bit)) <= value)
+			root |= bit;
+
+	return(root);
+}
+
+// ramps on led strings are interpolated per colour byte, everything else as a single value
+
+static unsigned int ramp_lane_value(const sequencer_ramp_state_t *ramp, unsigned int value, unsigned int lane)
+{
+	if(ramp->lanes == 1)
+		return(value);
+
+	return((value >> (lane * 8)) & 0xff);
+}
+
+static void ramp_begin(sequencer_ramp_state_t *ramp, unsigned int io, unsigned int pin, unsigned int value, unsigned int duration, sequencer_ramp_t type)
+{
+	unsigned int lane, from, to;
+
+	if(io_read_pin((string_t *)0, io, pin, &ramp->last) != io_ok)
+		ramp->last = 0;
+
+	ramp->io = io;
+	ramp->pin = pin;
+	ramp->lanes = (io == io_id_ledpixel) ? ramp_lanes_max : 1;
+	ramp->target = value;
+	ramp->start_time = time_get_us() / 1000;
+	ramp->duration = duration;
+
+	// gamma 2: interpolate linearly between the square roots and square again on output,
+	// values up to 16 bits are scaled up first to keep 8 bits of fraction in the roots
+
+	ramp->shift = ((ramp->last > 0xffff) || (value > 0xffff)) && (ramp->lanes == 1) ? 0 : 16;
+
+	for(lane = 0; lane < ramp->lanes; lane++)
+	{
+		from = ramp_lane_value(ramp, ramp->last, lane);
+		to = ramp_lane_value(ramp, value, lane);
+
+		if(type == sequencer_ramp_gamma)
 		{
-			sequencer_stop();
+			from = isqrt(from << ramp->shift);
+			to = isqrt(to << ramp->shift);
+		}
+
+		ramp->from[lane] = from;
+		ramp->to[lane] = to;
+	}
+
+	ramp->type = type;
+}
+
+static void ramp_end(sequencer_ramp_state_t *ramp)
+{
+	if(ramp->type == sequencer_ramp_none)
+		return;
+
+	ramp->type = sequencer_ramp_none;
+
+	if(ramp->last != ramp->target)
+		io_write_pin((string_t *)0, ramp->io, ramp->pin, ramp->target);
+}
+
+static void ramp_run(sequencer_ramp_state_t *ramp, uint64_t now)
+{
+	unsigned int lane, elapsed, value, lane_value, from, to;
+
+	if(ramp->type == sequencer_ramp_none)
+		return;
+
+	elapsed = now - ramp->start_time;
+
+	if(elapsed >= ramp->duration)
+	{
+		ramp_end(ramp);
+		return;
+	}
+
+	for(lane = 0, value = 0; lane < ramp->lanes; lane++)
+	{
+		from = ramp->from[lane];
+		to = ramp->to[lane];
+
+		if(to >= from)
+			lane_value = from + (unsigned int)(((uint64_t)(to - from) * elapsed) / ramp->duration);
+		else
+			lane_value = from - (unsigned int)(((uint64_t)(from - to) * elapsed) / ramp->duration);
+
+		if(ramp->type == sequencer_ramp_gamma)
+			lane_value = (lane_value * lane_value) >> ramp->shift;
+
+		if(ramp->lanes == 1)
+			value = lane_value;
+		else
+			value |= (lane_value & 0xff) << (lane * 8);
+	}
+
+	if(value != ramp->last)
+	{
+		ramp->last = value;
+		io_write_pin((string_t *)0, ramp->io, ramp->pin, value);
+	}
+}
+
+// called from io_periodic_fast: run active ramps, the entries themselves are stepped from the sequencer timer
+
+void sequencer_periodic(void)
+{
+	unsigned int track;
+	uint64_t now;
+
+	now = time_get_us() / 1000;
+
+	for(track = 0; track < sequencer_tracks; track++)
+		if(sequencer.track[track].repeats > 0)
+			ramp_run(&sequencer.track[track].ramp, now);
+}
+
+// fetch the entry following the current one from flash in advance, so the timer callback only needs to write the pin
+
+static void track_prefetch(sequencer_track_t *tp)
+{
+	sequencer_prefetch_t *next;
+	bool active;
+
+	next = &tp->next;
+
+	next->valid = 0;
+	next->wrap = 0;
+	next->index = tp->current + 1;
+
+	if(!sequencer_get_entry(next->index, &active, &next->io, &next->pin, &next->value, &next->duration, &next->ramp) || !active)
+	{
+		next->wrap = 1;
+		next->index = tp->start;
+
+		if(!sequencer_get_entry(next->index, &active, &next->io, &next->pin, &next->value, &next->duration, &next->ramp) || !active)
+			return;
+	}
+
+	next->valid = 1;
+}
+
+static void track_run(unsigned int track, uint64_t now)
+{
+	sequencer_track_t *tp;
+	const sequencer_prefetch_t *next;
+
+	tp = &sequencer.track[track];
+	next = &tp->next;
+
+	ramp_end(&tp->ramp);
+
+	if(!next->valid || (next->wrap && (--tp->repeats <= 0)))
+	{
+		sequencer_stop(track);
+		return;
+	}
+
+	if((next->ramp == sequencer_ramp_none) || (next->duration == 0))
+		io_write_pin((string_t *)0, next->io, next->pin, next->value);
+	else
+		ramp_begin(&tp->ramp, next->io, next->pin, next->value, next->duration, next->ramp);
+
+	// schedule from the previous deadline instead of from now, so lateness doesn't accumulate
+
+	if(tp->current_end_time == 0)
+		tp->current_end_time = now;
+
+	tp->current_end_time += (uint64_t)next->duration * 1000;
+	tp->current = next->index;
+
+	track_prefetch(tp);
+
+	// the next entry is outside the cache window, have it moved from a task, not from the timer
+
+	if(cache.valid && tp->next.valid && !cache_contains(tp->next.index + 1) && !cache.refill_posted)
+		cache.refill_posted = dispatch_post_task(task_prio_low, task_sequencer_cache_refill, 0, 0, 0);
+}
+
+static bool next_deadline(uint64_t *deadline)
+{
+	unsigned int track;
+	bool found;
+
+	found = false;
+
+	for(track = 0; track < sequencer_tracks; track++)
+	{
+		if(sequencer.track[track].repeats <= 0)
+			continue;
+
+		if(!found || (sequencer.track[track].current_end_time < *deadline))
+			*deadline = sequencer.track[track].current_end_time;
+
+		found = true;
+	}
+
+	return(found);
+}
+
+static void timer_arm(void)
+{
+	uint64_t deadline, now;
+	unsigned int delay_ms;
+
+	os_timer_disarm(&sequencer.timer);
+
+	if(!next_deadline(&deadline))
+		return;
+
+	now = time_get_us();
+
+	if(deadline > now)
+		delay_ms = (deadline - now) / 1000;
+	else
+		delay_ms = 0;
+
+	os_timer_arm(&sequencer.timer, delay_ms, 0);
+}
+
+static void timer_callback(void *arg)
+{
+	uint64_t deadline, now;
+
+	if(!next_deadline(&deadline))
+		return;
+
+	now = time_get_us();
+
+	// never busy-wait for more than a few tens of microseconds in the sdk's timer
+	// context, entries that are due within the timer's resolution are run early
+
+	if(deadline > now)
+	{
+		if((deadline - now) > sequencer_early_max_us)
+		{
+			timer_arm();
 			return;
 		}
+
+		if((deadline - now) <= sequencer_spin_max_us)
+			while(time_get_us() < deadline)
+				csleep(1);
 	}
 
-	sequencer.current_end_time = (time_get_us() / 1000) + duration;
+	sequencer_run();
+}
+
+void sequencer_run(void)
+{
+	unsigned int track;
+	uint64_t now;
+	sequencer_track_t *tp;
+
+	now = time_get_us();
+
+	for(track = 0; track < sequencer_tracks; track++)
+	{
+		tp = &sequencer.track[track];
+
+		if((tp->repeats > 0) && ((now + sequencer_early_max_us) >= tp->current_end_time))
+		{
+			if((tp->current_end_time > 0) && (now > tp->current_end_time))
+			{
+				sequencer.late_last_us = now - tp->current_end_time;
+
+				if(sequencer.late_last_us > sequencer.late_max_us)
+					sequencer.late_max_us = sequencer.late_last_us;
+			}
+
+			track_run(track, now);
+		}
+	}
 
-	io_write_pin((string_t *)0, io, pin, value);
+	timer_arm();
 }
@@ -7,19 +7,39 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-int			sequencer_get_current(void);
-int			sequencer_get_start(void);
-uint64_t	sequencer_get_current_end_time(void);
-int			sequencer_get_repeats(void);
-void		sequencer_get_status(bool *running, unsigned int *start, unsigned int *flash_size, unsigned int *flash_size_entries,
-				unsigned int *flash_offset_flash0, unsigned int *flash_offset_flash1, unsigned int *flash_offset_mapped);
+typedef enum
+{
+	sequencer_ramp_none = 0,
+	sequencer_ramp_linear,
+	sequencer_ramp_gamma,
+	sequencer_ramp_size,
+} sequencer_ramp_t;
+
+enum
+{
+	sequencer_tracks = 4,
+};
+
+int			sequencer_get_current(unsigned int track);
+int			sequencer_get_start(unsigned int track);
+uint64_t	sequencer_get_current_end_time(unsigned int track);
+int			sequencer_get_repeats(unsigned int track);
+void		sequencer_get_status(bool *running, unsigned int *tracks, unsigned int *late_last_us, unsigned int *late_max_us, unsigned int *flash_size,
+				unsigned int *flash_size_entries, unsigned int *flash_offset_flash0, unsigned int *flash_offset_flash1, unsigned int *flash_offset_mapped);
 void		sequencer_run(void);
+void		sequencer_periodic(void);
 void		sequencer_init(void);
 bool		sequencer_clear(void);
-void		sequencer_start(unsigned int start, unsigned int repeats);
-void		sequencer_stop(void);
-bool		sequencer_set_entry(unsigned int entry, int io, int pin, uint32_t value, int duration);
-bool		sequencer_get_entry(unsigned int entry, bool *active, int *io, int *pin, unsigned int *value, unsigned int *duration);
+bool		sequencer_start(unsigned int track, unsigned int start, unsigned int repeats);
+bool		sequencer_stop(unsigned int track);
+void		sequencer_stop_all(void);
+bool		sequencer_set_entry(unsigned int entry, int io, int pin, uint32_t value, unsigned int duration, sequencer_ramp_t ramp);
+bool		sequencer_get_entry(unsigned int entry, bool *active, int *io, int *pin, unsigned int *value, unsigned int *duration, sequencer_ramp_t *ramp);
 bool		sequencer_remove_entry(unsigned int entry);
+bool		sequencer_upload(unsigned int sector, unsigned int length, void *data);
+void		sequencer_cache_refill(void);
+void		sequencer_get_cache_status(bool *enabled, bool *valid, unsigned int *first, unsigned int *entries, unsigned int *hits, unsigned int *misses);
+bool		sequencer_ramp_from_string(const string_t *src, sequencer_ramp_t *ramp);
+void		sequencer_ramp_to_string(string_t *dst, sequencer_ramp_t ramp);
 
 #endif
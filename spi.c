@@ -30,6 +30,7 @@ typedef struct attr_packed
 	unsigned int inited:1;
 	unsigned int configured:1;
 	unsigned int cs_hold:1;
+	unsigned int streaming:1;
 	unsigned int spi_mode:4;
 	unsigned int receive_bytes:8;
 
@@ -91,10 +92,40 @@ attr_inline void wait_completion(void)
 		stat_spi_wait_cycles++;
 }
 
+static bool clock_register(spi_clock_t clock, unsigned int *spi_clock)
+{
+	const spi_clock_map_t *clock_map_ptr;
+	unsigned int clock_pre_div, clock_div;
+	unsigned int clock_high, clock_low;
+
+	for(clock_map_ptr = spi_clock_map; clock_map_ptr->clock != spi_clock_none; clock_map_ptr++)
+		if(clock_map_ptr->clock == clock)
+			break;
+
+	if(clock_map_ptr->clock == spi_clock_none)
+		return(false);
+
+	clock_pre_div = clock_map_ptr->pre_div - 1;
+	clock_div =		clock_map_ptr->div - 1;
+	clock_high =	((clock_div + 1) / 2) - 1;
+	clock_low =		clock_div;
+
+	*spi_clock =	((clock_pre_div	& SPI_CLKDIV_PRE)	<< SPI_CLKDIV_PRE_S)	|
+					((clock_div		& SPI_CLKCNT_N)		<< SPI_CLKCNT_N_S)		|
+					((clock_high	& SPI_CLKCNT_H)		<< SPI_CLKCNT_H_S)		|
+					((clock_low		& SPI_CLKCNT_L)		<< SPI_CLKCNT_L_S);
+
+	if(clock == spi_clock_80M)
+		*spi_clock |= SPI_CLK_EQU_SYSCLK;
+
+	return(true);
+}
+
 bool spi_init(string_t *error, unsigned int io)
 {
 	state.inited = 0;
 	state.configured = 0;
+	state.streaming = 0;
 
 	if(io != 0)
 	{
@@ -179,6 +210,13 @@ bool spi_start(string_t *error)
 		return(false);
 	}
 
+	if(state.streaming)
+	{
+		if(error)
+			string_append(error, "spi start: stream active\n");
+		return(false);
+	}
+
 	send_buffer.bits = 0;
 	send_buffer.word = 0;
 	send_buffer.bit = 0;
@@ -294,9 +332,6 @@ attr_result_used bool spi_transmit(string_t *error, spi_clock_t clock,
 		unsigned int skip_bits,
 		unsigned int receive_bytes)
 {
-	const spi_clock_map_t *clock_map_ptr;
-	unsigned int clock_pre_div, clock_div;
-	unsigned int clock_high, clock_low;
 	unsigned int w0cur, w0size;
 	unsigned int spi_user;
 	unsigned int spi_user1;
@@ -312,6 +347,13 @@ attr_result_used bool spi_transmit(string_t *error, spi_clock_t clock,
 		return(false);
 	}
 
+	if(state.streaming)
+	{
+		if(error)
+			string_append(error, "spi transmit: stream active");
+		return(false);
+	}
+
 	if((command_length_bits > 16) || (address_length_bits > 31) || (skip_bits > 8) || (receive_bytes > 64))
 	{
 		if(error)
@@ -322,11 +364,7 @@ attr_result_used bool spi_transmit(string_t *error, spi_clock_t clock,
 	if((command_length_bits == 0) && (address_length_bits == 0) && (send_buffer.bits == 0) && (receive_bytes == 0))
 		return(true);
 
-	for(clock_map_ptr = spi_clock_map; clock_map_ptr->clock != spi_clock_none; clock_map_ptr++)
-		if(clock_map_ptr->clock == clock)
-			break;
-
-	if(clock_map_ptr->clock == spi_clock_none)
+	if(!clock_register(clock, &spi_clock))
 	{
 		if(error)
 			string_append(error, "spi transmit: invalid speed");
@@ -385,19 +423,6 @@ attr_result_used bool spi_transmit(string_t *error, spi_clock_t clock,
 		state.receive_bytes = receive_bytes;
 	}
 
-	clock_pre_div = clock_map_ptr->pre_div - 1;
-	clock_div =		clock_map_ptr->div - 1;
-	clock_high =	((clock_div + 1) / 2) - 1;
-	clock_low =		clock_div;
-
-	spi_clock =	((clock_pre_div	& SPI_CLKDIV_PRE)	<< SPI_CLKDIV_PRE_S)	|
-				((clock_div		& SPI_CLKCNT_N)		<< SPI_CLKCNT_N_S)		|
-				((clock_high	& SPI_CLKCNT_H)		<< SPI_CLKCNT_H_S)		|
-				((clock_low		& SPI_CLKCNT_L)		<< SPI_CLKCNT_L_S);
-
-	if(clock == spi_clock_80M)
-		spi_clock |= SPI_CLK_EQU_SYSCLK;
-
 	if(state.cs_hold)
 		spi_user |= SPI_CS_SETUP | SPI_CS_HOLD;
 
@@ -492,6 +517,207 @@ attr_result_used bool spi_finish(string_t *error)
 	return(true);
 }
 
+// Streaming sends an arbitrary amount of data as a series of back-to-back
+// transactions without command, address or receive phase. The send buffer is
+// copied into the W0 registers as soon as it's full, so the next chunk can be
+// prepared while the previous one is still being clocked out. The user CS
+// remains asserted for the whole stream.
+
+static void stream_flush(bool keep)
+{
+	unsigned int w0cur, w0size;
+
+	if(send_buffer.bits == 0)
+		return;
+
+	if(send_buffer.bits > stat_spi_largest_chunk)
+		stat_spi_largest_chunk = send_buffer.bits;
+
+	w0size = (send_buffer.bits + (SPI_W0_REGISTER_BIT_WIDTH - 1)) / SPI_W0_REGISTER_BIT_WIDTH;
+
+	wait_completion();
+
+	for(w0cur = 0; w0cur < w0size; w0cur++)
+	{
+		write_peri_reg(SPI_W0(1) + (w0cur * 4), send_buffer.data[w0cur]);
+
+		if(!keep)
+			send_buffer.data[w0cur] = 0;
+	}
+
+	write_peri_reg(SPI_USER1(1), ((send_buffer.bits - 1) & SPI_USR_MOSI_BITLEN) << SPI_USR_MOSI_BITLEN_S);
+	set_peri_reg_mask(SPI_CMD(1), SPI_USR);
+
+	stat_spi_stream_chunks++;
+
+	if(!keep)
+	{
+		send_buffer.bits = 0;
+		send_buffer.word = 0;
+		send_buffer.bit = 0;
+	}
+}
+
+attr_result_used bool spi_stream_begin(string_t *error, spi_clock_t clock)
+{
+	unsigned int current;
+	unsigned int spi_user;
+	unsigned int spi_clock;
+
+	if(!state.inited || !state.configured)
+	{
+		if(error)
+			string_append(error, "spi stream begin: not inited or not configured");
+		return(false);
+	}
+
+	if(state.streaming)
+	{
+		if(error)
+			string_append(error, "spi stream begin: stream already active");
+		return(false);
+	}
+
+	if(!clock_register(clock, &spi_clock))
+	{
+		if(error)
+			string_append(error, "spi stream begin: invalid speed");
+		return(false);
+	}
+
+	spi_user = mode_table[state.spi_mode][1] ? SPI_CK_OUT_EDGE : 0;	// CPHA
+	spi_user |= SPI_USR_MOSI;
+
+	if(state.cs_hold)
+		spi_user |= SPI_CS_SETUP | SPI_CS_HOLD;
+
+	wait_completion();
+
+	write_peri_reg(SPI_ADDR(1), 0);
+	write_peri_reg(SPI_USER(1), spi_user);
+	write_peri_reg(SPI_USER1(1), 0);
+	write_peri_reg(SPI_USER2(1), 0);
+	write_peri_reg(SPI_CLOCK(1), spi_clock);
+	write_peri_reg(SPI_PIN(1), mode_table[state.spi_mode][0] ? SPI_IDLE_EDGE : 0);	// CPOL
+
+	send_buffer.bits = 0;
+	send_buffer.word = 0;
+	send_buffer.bit = 0;
+	send_buffer.fill = 0;
+
+	for(current = 0; current < SPI_W0_REGISTERS; current++)
+		send_buffer.data[current] = 0;
+
+	if(state.user_cs.enabled && (io_write_pin(error, state.user_cs.io, state.user_cs.pin, 1) != io_ok))
+	{
+		if(error)
+			string_append(error, "spi stream begin: user cs issue");
+		return(false);
+	}
+
+	state.streaming = 1;
+
+	return(true);
+}
+
+attr_result_used bool spi_stream_write(string_t *error, unsigned int bits, uint32_t value)
+{
+	if(!state.streaming || (bits > 32))
+	{
+		if(error)
+			string_append(error, "spi stream write: no stream active or invalid length");
+		return(false);
+	}
+
+	if(spi_write_bits_available() < bits)
+		stream_flush(false);
+
+	return(spi_write(bits, value));
+}
+
+attr_result_used bool spi_stream_bytes(string_t *error, unsigned int length, const uint8_t *data)
+{
+	unsigned int current;
+
+	for(current = 0; current < length; current++)
+		if(!spi_stream_write(error, 8, data[current]))
+			return(false);
+
+	return(true);
+}
+
+attr_result_used bool spi_stream_fill(string_t *error, unsigned int bits, uint32_t value, unsigned int count)
+{
+	unsigned int chunk, current;
+
+	if(!state.streaming || (bits == 0) || (bits > 32))
+	{
+		if(error)
+			string_append(error, "spi stream fill: no stream active or invalid length");
+		return(false);
+	}
+
+	for(; (count > 0) && (spi_write_bits_available() >= bits); count--)
+		if(!spi_write(bits, value))
+			return(false);
+
+	if(count == 0)
+		return(true);
+
+	stream_flush(false);
+
+	// from here on every full chunk has the same contents, build it once and send it repeatedly
+
+	chunk = send_buffer.bits_available / bits;
+
+	if(count >= chunk)
+	{
+		for(current = 0; current < chunk; current++)
+			if(!spi_write(bits, value))
+				return(false);
+
+		for(; count >= chunk; count -= chunk)
+			stream_flush(true);
+
+		for(current = 0; current < SPI_W0_REGISTERS; current++)
+			send_buffer.data[current] = 0;
+
+		send_buffer.bits = 0;
+		send_buffer.word = 0;
+		send_buffer.bit = 0;
+	}
+
+	for(; count > 0; count--)
+		if(!spi_write(bits, value))
+			return(false);
+
+	return(true);
+}
+
+attr_result_used bool spi_stream_end(string_t *error)
+{
+	if(!state.streaming)
+	{
+		if(error)
+			string_append(error, "spi stream end: no stream active");
+		return(false);
+	}
+
+	stream_flush(false);
+	wait_completion();
+
+	state.streaming = 0;
+
+	if(state.user_cs.enabled && (io_write_pin(error, state.user_cs.io, state.user_cs.pin, 0) != io_ok))
+	{
+		if(error)
+			string_append(error, "spi stream end: user cs issue");
+		return(false);
+	}
+
+	return(true);
+}
+
 roflash const char help_description_spi_configure[] = "configure SPI interface\n"
 		"> usage: spc <mode=0-3> <cs delay=0|1> [<user cs io> <user cs pin>]\n";
 
@@ -64,6 +64,11 @@ attr_result_used bool spi_transmit(string_t *error, spi_clock_t clock,
 		unsigned int command_length_bits, unsigned int command, unsigned int address_length_bits, unsigned int address, unsigned int skip_bits, unsigned int receive_bytes);
 attr_result_used bool spi_receive(string_t *error, unsigned int receive_bytes, uint8_t *receive_data);
 attr_result_used bool spi_finish(string_t *error);
+attr_result_used bool spi_stream_begin(string_t *error, spi_clock_t clock);
+attr_result_used bool spi_stream_write(string_t *error, unsigned int bits, uint32_t value);
+attr_result_used bool spi_stream_bytes(string_t *error, unsigned int length, const uint8_t *data);
+attr_result_used bool spi_stream_fill(string_t *error, unsigned int bits, uint32_t value, unsigned int count);
+attr_result_used bool spi_stream_end(string_t *error);
 
 attr_result_used app_action_t application_function_spi_configure(app_params_t *);
 attr_result_used app_action_t application_function_spi_start(app_params_t *);
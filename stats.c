@@ -77,6 +77,8 @@ unsigned int stat_i2c_sda_stucks;
 unsigned int stat_i2c_sda_stuck_max_period;
 unsigned int stat_i2c_bus_locks;
 unsigned int stat_i2c_bus_lock_max_period;
+unsigned int stat_i2c_clock_stretches;
+unsigned int stat_i2c_clock_stretch_max_us;
 unsigned int stat_i2c_soft_resets;
 unsigned int stat_i2c_hard_resets;
 
@@ -89,6 +91,7 @@ unsigned int stat_spi_wait_cycles;
 unsigned int stat_spi_largest_chunk;
 unsigned int stat_spi_8;
 unsigned int stat_spi_16;
+unsigned int stat_spi_stream_chunks;
 
 unsigned int stat_font_render_time;
 
@@ -378,7 +381,8 @@ void stats_counters(string_t *dst)
 			">  spi wait cycles:        %u\n"
 			">  spi max chunk size:     %u\n"
 			">  write_8 used:           %u\n"
-			">  write_16 used:          %u\n",
+			">  write_16 used:          %u\n"
+			">  spi stream chunks:      %u\n",
 				stat_pc_counts,
 				stat_renc_invalid_state,
 				stat_update_display,
@@ -387,7 +391,8 @@ void stats_counters(string_t *dst)
 				stat_update_uart,
 				stat_spi_wait_cycles,
 				stat_spi_largest_chunk / 8,
-				stat_spi_8, stat_spi_16);
+				stat_spi_8, stat_spi_16,
+				stat_spi_stream_chunks);
 
 	string_format(dst,
 			">\n> DEBUG COUNTERS\n"
@@ -478,6 +483,8 @@ void stats_i2c(string_t *dst)
 			"> i2c sda max stuck periods: %u\n"
 			"> i2c bus locks: %u\n"
 			"> i2c bus max locked periods: %u\n"
+			"> i2c clock stretches: %u\n"
+			"> i2c clock max stretch: %u us\n"
 			"> i2c soft resets: %u\n"
 			"> i2c hard resets: %u\n"
 			"> i2c multiplexer found: %s\n"
@@ -486,6 +493,8 @@ void stats_i2c(string_t *dst)
 				stat_i2c_sda_stuck_max_period,
 				stat_i2c_bus_locks,
 				stat_i2c_bus_lock_max_period,
+				stat_i2c_clock_stretches,
+				stat_i2c_clock_stretch_max_us,
 				stat_i2c_soft_resets,
 				stat_i2c_hard_resets,
 				yesno(i2c_info.multiplexer),
@@ -508,7 +517,11 @@ void stats_i2c(string_t *dst)
 			"> i2c sensors detect current sensor id: %u\n"
 			"> i2c sensors detect started: %s\n"
 			"> i2c sensors detect finished: %s\n"
-			"> i2c sensors detect duration: %u ms\n",
+			"> i2c sensors detect duration: %u ms\n"
+			"> i2c sensors detect known: %u, verified: %u\n"
+			"> i2c sensors detect probed: %u, acked: %u, skip absent: %u\n"
+			"> i2c sensors rescan started: %s, finished: %s, found: %u\n"
+			"> i2c sensors rescan current bus: %u, sensor id: %u\n",
 				i2c_sensor_info.detect_called,
 				i2c_sensor_info.detect_succeeded,
 				i2c_sensor_info.detect_bus_select_failed,
@@ -523,7 +536,17 @@ void stats_i2c(string_t *dst)
 				i2c_sensor_info.detect_current_sensor,
 				yesno(i2c_sensor_info.detect_started),
 				yesno(i2c_sensor_info.detect_finished),
-				(uint32_t)((i2c_sensor_info.detect_finished_us - i2c_sensor_info.detect_started_us) / 1000));
+				(uint32_t)((i2c_sensor_info.detect_finished_us - i2c_sensor_info.detect_started_us) / 1000),
+				i2c_sensor_info.detect_known,
+				i2c_sensor_info.detect_known_verified,
+				i2c_sensor_info.detect_probed,
+				i2c_sensor_info.detect_probe_acked,
+				i2c_sensor_info.detect_skip_absent,
+				yesno(i2c_sensor_info.rescan_started),
+				yesno(i2c_sensor_info.rescan_finished),
+				i2c_sensor_info.rescan_found,
+				i2c_sensor_info.rescan_current_bus,
+				i2c_sensor_info.rescan_current_sensor);
 
 	string_format(dst,
 			"> i2c sensors init called: %u\n"
@@ -550,12 +573,19 @@ void stats_i2c(string_t *dst)
 			"> i2c sensors background failed: %u\n"
 			"> i2c sensors background wrapped: %u\n"
 			"> i2c sensors background current sensor: %u\n"
-			"> i2c sensors background finished: %u\n",
+			"> i2c sensors background finished: %u\n"
+			"> i2c sensors sampled: %u, failed: %u, served from cache: %u\n"
+			"> i2c sensors samples not due: %u, added to history: %u\n",
 				i2c_sensor_info.background_called,
 				i2c_sensor_info.background_bus_select_failed,
 				i2c_sensor_info.background_succeeded,
 				i2c_sensor_info.background_failed,
 				i2c_sensor_info.background_wrapped,
 				i2c_sensor_info.background_current_sensor,
-				i2c_sensor_info.background_finished);
+				i2c_sensor_info.background_finished,
+				i2c_sensor_info.sample_called,
+				i2c_sensor_info.sample_failed,
+				i2c_sensor_info.sample_cached,
+				i2c_sensor_info.sample_not_due,
+				i2c_sensor_info.sample_history);
 }
@@ -104,6 +104,7 @@ extern unsigned int stat_spi_largest_chunk;
 extern unsigned int stat_spi_wait_cycles;
 extern unsigned int stat_spi_8;
 extern unsigned int stat_spi_16;
+extern unsigned int stat_spi_stream_chunks;
 
 extern int stat_debug_1;
 extern int stat_debug_2;
@@ -114,6 +115,8 @@ extern unsigned int stat_i2c_sda_stucks;
 extern unsigned int stat_i2c_sda_stuck_max_period;
 extern unsigned int stat_i2c_bus_locks;
 extern unsigned int stat_i2c_bus_lock_max_period;
+extern unsigned int stat_i2c_clock_stretches;
+extern unsigned int stat_i2c_clock_stretch_max_us;
 extern unsigned int stat_i2c_soft_resets;
 extern unsigned int stat_i2c_hard_resets;
 
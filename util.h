@@ -59,6 +59,8 @@ typedef enum
 	fsb_sequencer,
 	fsb_display_picture,
 	fsb_rboot,
+	fsb_flash_checksum,
+	fsb_flash_erase_ahead,
 } flash_sector_buffer_use_t;
 
 #define flash_buffer_request(use, pvt, descr, str, cstr, size) \
@@ -84,6 +86,7 @@ bool flash_buffer_using_3(flash_sector_buffer_use_t one, flash_sector_buffer_use
 
 double pow(double, double);
 double fmax(double, double);
+double sqrt(double);
 
 void reset(void);
 const char *yesno(bool value);